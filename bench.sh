@@ -0,0 +1,242 @@
+#!/bin/sh
+# Measures how long it takes from calling volnoti-show until the popup is
+# painted. The daemon runs against a private D-Bus session bus and a
+# private Xvfb display, and reports every expose in verbose mode. Each
+# call is matched with the first expose that follows it. The cold cases
+# stop the daemon before each call and let the bus activate it again.
+#
+# Usage: bench.sh <builddir> <resdir> [-n <calls>] [-r <calls per second>] [-c <cold starts>]
+#
+# Needs Xvfb, dbus-daemon, stdbuf and a date(1) that supports %N.
+
+set -e
+
+BUILDDIR=$1
+RESDIR=$2
+shift 2
+
+COUNT=50
+RATE=20
+COLD_COUNT=10
+TIMEOUT=0.2 # popup timeout of the daemon in seconds
+DISPLAY_NUMBER=${BENCH_DISPLAY:-99}
+
+while getopts "n:r:c:" option; do
+    case $option in
+        n) COUNT=$OPTARG ;;
+        r) RATE=$OPTARG ;;
+        c) COLD_COUNT=$OPTARG ;;
+        *) echo "Usage: $0 <builddir> <resdir> [-n <calls>] [-r <calls per second>] [-c <cold starts>]" >&2; exit 1 ;;
+    esac
+done
+
+for tool in Xvfb dbus-daemon stdbuf; do
+    if ! command -v $tool > /dev/null; then
+        echo "bench: $tool is required" >&2
+        exit 1
+    fi
+done
+
+WORKDIR=$(mktemp -d)
+XVFB_PID=
+DBUS_PID=
+DAEMON_PID=
+
+# runs on every exit, so a process that already died mustn't stop it early
+cleanup() {
+    set +e
+    [ -n "$DAEMON_PID" ] && kill $DAEMON_PID 2> /dev/null || true
+    [ -f "$WORKDIR/daemon.pid" ] && kill $(cat "$WORKDIR/daemon.pid") 2> /dev/null || true
+    [ -n "$DBUS_PID" ] && kill $DBUS_PID 2> /dev/null || true
+    [ -n "$XVFB_PID" ] && kill $XVFB_PID 2> /dev/null || true
+    rm -rf "$WORKDIR"
+}
+trap cleanup EXIT INT TERM
+
+now() {
+    date +%s%6N
+}
+
+# private X server and session bus
+Xvfb :$DISPLAY_NUMBER -screen 0 1280x1024x24 -nolisten tcp > /dev/null 2>&1 &
+XVFB_PID=$!
+DISPLAY=:$DISPLAY_NUMBER
+export DISPLAY
+sleep 1
+
+# keeps the raster cache of the daemon out of the user's cache
+XDG_CACHE_HOME=$WORKDIR/cache
+export XDG_CACHE_HOME
+
+# the bus activates the daemon through this script in the cold cases
+mkdir "$WORKDIR/services"
+cat > "$WORKDIR/activate.sh" <<EOF
+#!/bin/sh
+echo \$\$ > "$WORKDIR/daemon.pid"
+DISPLAY=$DISPLAY
+VOLNOTI_DATADIR=$RESDIR/
+export DISPLAY VOLNOTI_DATADIR
+exec stdbuf -oL "$BUILDDIR/volnoti" -n -v -t $TIMEOUT >> "$WORKDIR/daemon.log" 2>&1
+EOF
+cat > "$WORKDIR/services/uk.ac.cam.db538.volume-notification.service" <<EOF
+[D-BUS Service]
+Name=uk.ac.cam.db538.volume-notification
+Exec=/bin/sh $WORKDIR/activate.sh
+EOF
+cat > "$WORKDIR/bus.conf" <<EOF
+<!DOCTYPE busconfig PUBLIC "-//freedesktop//DTD D-BUS Bus Configuration 1.0//EN"
+ "http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd">
+<busconfig>
+  <type>session</type>
+  <listen>unix:tmpdir=$WORKDIR</listen>
+  <servicedir>$WORKDIR/services</servicedir>
+  <policy context="default">
+    <allow send_destination="*"/>
+    <allow own="*"/>
+  </policy>
+</busconfig>
+EOF
+
+BUS=$(dbus-daemon --config-file="$WORKDIR/bus.conf" --fork --print-address=1 --print-pid=1)
+DBUS_SESSION_BUS_ADDRESS=$(echo "$BUS" | sed -n 1p)
+DBUS_PID=$(echo "$BUS" | sed -n 2p)
+export DBUS_SESSION_BUS_ADDRESS
+
+VOLNOTI_DATADIR=$RESDIR/ stdbuf -oL "$BUILDDIR/volnoti" -n -v -t $TIMEOUT \
+    > "$WORKDIR/daemon.log" 2>&1 &
+DAEMON_PID=$!
+
+for attempt in 1 2 3 4 5 6 7 8 9 10; do
+    grep -q "Registered the service" "$WORKDIR/daemon.log" && break
+    sleep 0.5
+done
+
+if ! grep -q "Registered the service" "$WORKDIR/daemon.log"; then
+    echo "bench: the daemon did not start" >&2
+    cat "$WORKDIR/daemon.log" >&2
+    exit 1
+fi
+
+# run <name> <seconds between calls> [volnoti-show arguments]
+run() {
+    name=$1
+    interval=$2
+    shift 2
+
+    : > "$WORKDIR/sent"
+    call=0
+
+    while [ $call -lt $COUNT ]; do
+        now >> "$WORKDIR/sent"
+        "$BUILDDIR/volnoti-show" "$@" $((call % 101)) > /dev/null
+        call=$((call + 1))
+        sleep $interval
+    done
+
+    # let the last popup paint and hide
+    sleep 1
+
+    report "$name"
+}
+
+# report <name>: matches the calls in sent with the exposes in the log
+report() {
+    grep "^Painted at" "$WORKDIR/daemon.log" | awk '{ print $3 }' > "$WORKDIR/painted"
+
+    awk -v name="$1" '
+        BEGIN { first = 0 }
+        NR == FNR { painted[n++] = $1 + 0; next }
+        {
+            sent = $1 + 0;
+
+            while(first < n && painted[first] < sent)
+                first++;
+
+            if(first < n)
+                latency[count++] = painted[first] - sent;
+            else
+                missed++;
+        }
+        END {
+            for(i = 1; i < count; i++)
+                for(j = i; j > 0 && latency[j - 1] > latency[j]; j--)
+                {
+                    swap = latency[j];
+                    latency[j] = latency[j - 1];
+                    latency[j - 1] = swap;
+                }
+
+            if(count == 0)
+            {
+                printf("%-24s no popup was painted\n", name);
+                exit;
+            }
+
+            printf("%-24s p50 %8.2f ms  p99 %8.2f ms  max %8.2f ms  (%d calls, %d unpainted)\n",
+                name,
+                latency[int(count * 0.50)] / 1000,
+                latency[int(count * 0.99)] / 1000,
+                latency[count - 1] / 1000,
+                count, missed + 0);
+        }' "$WORKDIR/painted" "$WORKDIR/sent"
+}
+
+# stops the daemon started by the bus, if it runs
+stop_activated() {
+    [ -f "$WORKDIR/daemon.pid" ] || return 0
+
+    pid=$(cat "$WORKDIR/daemon.pid")
+    rm -f "$WORKDIR/daemon.pid"
+    kill $pid 2> /dev/null || return 0
+
+    while kill -0 $pid 2> /dev/null; do
+        sleep 0.05
+    done
+}
+
+# run_cold <name> [volnoti-show arguments]
+run_cold() {
+    name=$1
+    shift
+
+    : > "$WORKDIR/sent"
+    call=0
+
+    while [ $call -lt $COLD_COUNT ]; do
+        stop_activated
+        now >> "$WORKDIR/sent"
+        "$BUILDDIR/volnoti-show" "$@" 50 > /dev/null
+        call=$((call + 1))
+        sleep 1
+    done
+
+    stop_activated
+    report "$name"
+}
+
+INTERVAL=$(awk -v rate=$RATE 'BEGIN { printf("%.4f", 1 / rate) }')
+HIDDEN=$(awk -v timeout=$TIMEOUT 'BEGIN { printf("%.4f", timeout * 2) }')
+ICON=$RESDIR/play.svg
+
+echo "volnoti latency from calling volnoti-show to the popup being painted"
+echo "$COUNT calls per case; reused: $RATE calls/s; fresh: popup hidden before each call"
+echo "$COLD_COUNT calls per cold case, each starting the daemon through D-Bus activation"
+echo
+
+# fresh: the popup has timed out and is shown again; reused: it is still visible
+run "fresh builtin" $HIDDEN
+run "fresh builtin label" $HIDDEN -t "bench label"
+run "fresh custom" $HIDDEN -p "$ICON"
+run "fresh custom label" $HIDDEN -p "$ICON" -t "bench label"
+run "reused builtin" $INTERVAL
+run "reused builtin label" $INTERVAL -t "bench label"
+run "reused custom" $INTERVAL -p "$ICON"
+run "reused custom label" $INTERVAL -p "$ICON" -t "bench label"
+
+# cold: the daemon isn't running and the bus has to start it first
+kill $DAEMON_PID
+wait $DAEMON_PID 2> /dev/null || true
+DAEMON_PID=
+
+run_cold "cold builtin"
+run_cold "cold custom" -p "$ICON"
@@ -18,14 +18,14 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <getopt.h>
 #include <glib.h>
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 #include <unistd.h>
 
 #include "common.h"
-#include <unistd.h>
-
-#include "value-client-stub.h"
+#include "sharedstate.h"
 
 #define MAX_PROGRESSBAR_VALUE 101
 
@@ -34,6 +34,10 @@ static void print_usage(const char *filename, int failure)
     g_print("Usage: %s [-v] [-m] <value>\n"
         " -h\thelp\n"
         " -v\tverbose\n"
+        " -s\tread commands from standard input, see below (--stdin)\n"
+        " -n\tdo not wait for the daemon to handle the notification (--no-reply)\n"
+        " -C\tshow the notification in the popup of the named channel (--channel)\n"
+        " -S\twrite plain values to the shared memory of a daemon started with --shm (--shm)\n"
 
         " \nThese options must be followed by an integer for the progressbar:\n"
         " -m\tvolume muted\n"
@@ -58,7 +62,22 @@ static void print_usage(const char *filename, int failure)
         " -x\tFont color for the label\n"
         " Usage example:\n"
         " \t$ volnoti-show -p /home/chad/svgs/play.svg -t \"Can you feel my heart\" -f \"Fira Code 8\" -x \"#FFFFFF\" 20\n"
-        " Note: The default label color is #E6E6E6\n",
+        " Note: The default label color is #E6E6E6\n"
+
+        " \nWith -s, one notification is sent per line over a single connection.\n"
+        " Arguments may be quoted as in the shell, and the label is optional:\n"
+        " \tvol <value> [label]\n"
+        " \tmute [value] [label]\n"
+        " \tmic muted|on [value] [label]\n"
+        " \tbright <value> [label]\n"
+        " \tcustom <path> [value] [label]\n"
+        " Usage example:\n"
+        " \t$ echo 'custom /home/chad/svgs/play.svg 73 \"Can you feel my heart\"' | volnoti-show -s\n"
+        " The -f and -x options apply to every label.\n"
+
+        " \nEvery channel has its own popup, so for example brightness changes\n"
+        " don't replace the volume popup:\n"
+        " \t$ volnoti-show -C brightness -b 40\n",
         filename, MAX_PROGRESSBAR_VALUE, MAX_PROGRESSBAR_VALUE);
 
     if(failure)
@@ -67,24 +86,263 @@ static void print_usage(const char *filename, int failure)
         exit(EXIT_SUCCESS);
 }
 
+// D-Bus has no NULL strings, the daemon reads an empty one as unset
+#define EMPTY_IF_NULL(string) ((string) != NULL ? (string) : "")
+
+// everything beyond a value and its type goes over D-Bus
+static gboolean use_shared(SharedState *shared, int valueType, char *customLabel, char *channel)
+{
+    return shared != NULL && valueType != CUSTOM && customLabel == NULL && channel == NULL;
+}
+
+static gboolean send_notification(GDBusConnection *bus,
+    SharedState *shared,
+    int noReply,
+    char *channel,
+    int value,
+    int valueType,
+    char *customIconPath,
+    char *customLabel,
+    char *customLabelFont,
+    char *customLabelColor,
+    int debug)
+{
+    GError *error = NULL;
+    const char *method = "notify";
+    GVariant *parameters;
+
+    if(use_shared(shared, valueType, customLabel, channel))
+    {
+        print_debug("Writing value to shared memory...", debug);
+
+        if(shared_state_write(shared, value, valueType))
+        {
+            print_debug_ok(debug);
+            return TRUE;
+        }
+
+        print_debug("the segment stays locked, using D-Bus\n", debug);
+
+        // connecting is left to the caller
+        if(bus == NULL)
+            return FALSE;
+    }
+
+    if(channel != NULL)
+    {
+        method = "notifyChannel";
+        parameters = g_variant_new("(siissss)",
+            channel,
+            value,
+            valueType,
+            EMPTY_IF_NULL(customIconPath),
+            EMPTY_IF_NULL(customLabel),
+            EMPTY_IF_NULL(customLabelFont),
+            EMPTY_IF_NULL(customLabelColor));
+    }
+    else
+        parameters = g_variant_new("(iissss)",
+            value,
+            valueType,
+            EMPTY_IF_NULL(customIconPath),
+            EMPTY_IF_NULL(customLabel),
+            EMPTY_IF_NULL(customLabelFont),
+            EMPTY_IF_NULL(customLabelColor));
+
+    print_debug("Sending value...", debug);
+
+    if(noReply)
+    {
+        /* Without a callback the call is sent with NO_REPLY_EXPECTED, so
+           only wait until it is written to the bus. */
+        g_dbus_connection_call(bus,
+            VALUE_SERVICE_NAME,
+            VALUE_SERVICE_OBJECT_PATH,
+            VALUE_SERVICE_INTERFACE,
+            method,
+            parameters,
+            NULL,
+            G_DBUS_CALL_FLAGS_NONE,
+            -1,
+            NULL,
+            NULL,
+            NULL);
+
+        if(!g_dbus_connection_flush_sync(bus, NULL, &error))
+        {
+            handle_error("Failed to send notification", error->message, FALSE);
+            g_clear_error(&error);
+            return FALSE;
+        }
+
+        print_debug_ok(debug);
+
+        return TRUE;
+    }
+
+    GVariant *reply = g_dbus_connection_call_sync(bus,
+        VALUE_SERVICE_NAME,
+        VALUE_SERVICE_OBJECT_PATH,
+        VALUE_SERVICE_INTERFACE,
+        method,
+        parameters,
+        G_VARIANT_TYPE_UNIT,
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        NULL,
+        &error);
+
+    if(reply == NULL)
+    {
+        g_dbus_error_strip_remote_error(error);
+        handle_error("Failed to send notification", error->message, FALSE);
+        g_clear_error(&error);
+        return FALSE;
+    }
+
+    g_variant_unref(reply);
+    print_debug_ok(debug);
+
+    return TRUE;
+}
+
+static gboolean parse_value(const char *arg, int *value)
+{
+    char *end;
+    long parsed = strtol(arg, &end, 10);
+
+    if(end == arg || *end != '\0')
+        return FALSE;
+
+    *value = (int) parsed;
+    return TRUE;
+}
+
+/* Turns one line of the --stdin protocol into the arguments of a notify
+   call. The strings returned point into args. */
+static gboolean parse_command(char **args,
+    int count,
+    int *value,
+    int *valueType,
+    char **customIconPath,
+    char **customLabel)
+{
+    int index = 1;
+
+    *value = 0;
+    *customIconPath = NULL;
+    *customLabel = NULL;
+
+    if(strcmp(args[0], "vol") == 0)
+        *valueType = VOL_UNMUTED;
+    else if(strcmp(args[0], "mute") == 0)
+        *valueType = VOL_MUTED;
+    else if(strcmp(args[0], "bright") == 0)
+        *valueType = BRIGHTNESS;
+    else if(strcmp(args[0], "mic") == 0 && count > 1 && strcmp(args[1], "muted") == 0)
+    {
+        *valueType = MIC_MUTED;
+        index++;
+    }
+    else if(strcmp(args[0], "mic") == 0 && count > 1 && strcmp(args[1], "on") == 0)
+    {
+        *valueType = MIC_UNMUTED;
+        index++;
+    }
+    else if(strcmp(args[0], "custom") == 0 && count > 1)
+    {
+        *valueType = CUSTOM;
+        *customIconPath = args[index++];
+    }
+    else
+        return FALSE;
+
+    gboolean value_required = *valueType == VOL_UNMUTED || *valueType == BRIGHTNESS;
+
+    if(index < count && parse_value(args[index], value))
+        index++;
+    else if(value_required)
+        return FALSE;
+
+    if(index < count)
+        *customLabel = args[index++];
+
+    return index == count;
+}
+
+static int run_stdin(GDBusConnection *bus,
+    SharedState *shared,
+    int noReply,
+    char *channel,
+    char *customLabelFont,
+    char *customLabelColor,
+    int debug)
+{
+    char *line = NULL;
+    size_t length = 0;
+    int status = EXIT_SUCCESS;
+
+    while(getline(&line, &length, stdin) != -1)
+    {
+        char **args = NULL;
+        int count = 0;
+        int value;
+        int valueType;
+        char *customIconPath;
+        char *customLabel;
+
+        g_strstrip(line);
+
+        if(line[0] == '\0' || line[0] == '#')
+            continue;
+
+        if(!g_shell_parse_argv(line, &count, &args, NULL)
+            || !parse_command(args, count, &value, &valueType, &customIconPath, &customLabel))
+        {
+            handle_error("Invalid command", line, FALSE);
+            status = EXIT_FAILURE;
+        }
+        else if(!send_notification(bus, shared, noReply, channel, value, valueType, customIconPath, customLabel,
+            customLabelFont, customLabelColor, debug))
+            status = EXIT_FAILURE;
+
+        g_strfreev(args);
+    }
+
+    free(line);
+
+    return status;
+}
+
 int main(int argc, char *argv[])
 {
     char *customIconPath = NULL;
     char *customLabel = NULL;
     char *customLabelFont = NULL;
     char *customLabelColor = "#E6E6E6";
+    char *channel = NULL;
 
     int value = 0;
     int valueType = VOL_UNMUTED;
     int debug = 0;
+    int readStdin = 0;
+    int noReply = 0;
+    int useShared = 0;
 
     opterr = 0;
 
-    const char *options = "vhm:c:u:b:p:t:x:f:";
+    const char *options = "vhsnSC:m:c:u:b:p:t:x:f:";
+    const struct option longOptions[] = {
+        { "stdin", no_argument, NULL, 's' },
+        { "no-reply", no_argument, NULL, 'n' },
+        { "channel", required_argument, NULL, 'C' },
+        { "shm", no_argument, NULL, 'S' },
+        { NULL, 0, NULL, 0 }
+    };
     int option;
     int iconSelected = 0;
 
-    while((option = getopt(argc, argv, options)) != -1)
+    while((option = getopt_long(argc, argv, options, longOptions, NULL)) != -1)
         switch(option)
         {
             case 'm':
@@ -143,6 +401,22 @@ int main(int argc, char *argv[])
                 debug = 1;
                 break;
 
+            case 's':
+                readStdin = 1;
+                break;
+
+            case 'n':
+                noReply = 1;
+                break;
+
+            case 'C':
+                channel = optarg;
+                break;
+
+            case 'S':
+                useShared = 1;
+                break;
+
             case '?':
                 print_usage(argv[0], 1);
 
@@ -158,16 +432,37 @@ int main(int argc, char *argv[])
                 break;
     }
 
-    DBusGConnection *bus = NULL;
-    DBusGProxy *proxy = NULL;
+    GDBusConnection *bus = NULL;
+    SharedState *shared = NULL;
     GError *error = NULL;
 
-    // initialize GObject
-    g_type_init();
+    if(useShared)
+    {
+        shared = shared_state_open(FALSE, &error);
+
+        // D-Bus still works when the daemon doesn't use shared memory
+        if(shared == NULL)
+        {
+            print_debug(error->message, debug);
+            print_debug(", using D-Bus\n", debug);
+            g_clear_error(&error);
+        }
+    }
+
+    // a single value doesn't need a D-Bus connection at all
+    if(!readStdin && use_shared(shared, valueType, customLabel, channel))
+    {
+        if(send_notification(NULL, shared, noReply, channel, value, valueType, customIconPath,
+            customLabel, customLabelFont, customLabelColor, debug))
+            return EXIT_SUCCESS;
+
+        shared_state_close(shared);
+        shared = NULL;
+    }
 
     // connect to D-Bus
     print_debug("Connecting to D-Bus...", debug);
-    bus = dbus_g_bus_get(DBUS_BUS_SESSION, &error);
+    bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
 
     if(error != NULL)
         handle_error("Couldn't connect to D-Bus",
@@ -176,41 +471,12 @@ int main(int argc, char *argv[])
 
     print_debug_ok(debug);
 
-    // get the proxy
-    print_debug("Getting proxy...", debug);
-    proxy = dbus_g_proxy_new_for_name(bus,
-        VALUE_SERVICE_NAME,
-        VALUE_SERVICE_OBJECT_PATH,
-        VALUE_SERVICE_INTERFACE);
+    if(readStdin)
+        return run_stdin(bus, shared, noReply, channel, customLabelFont, customLabelColor, debug);
 
-    if(proxy == NULL)
-        handle_error("Couldn't get a proxy for D-Bus",
-            "Unknown(dbus_g_proxy_new_for_name)",
-            TRUE);
-
-    print_debug_ok(debug);
-
-    print_debug("Sending value...", debug);
-
-    uk_ac_cam_db538_VolumeNotification_notify(
-        proxy,
-        value,
-        valueType,
-        customIconPath,
-        customLabel,
-        customLabelFont,
-        customLabelColor,
-        &error
-    );
-
-    if(error != NULL)
-    {
-        handle_error("Failed to send notification", error->message, FALSE);
-        g_clear_error(&error);
+    if(!send_notification(bus, shared, noReply, channel, value, valueType, customIconPath, customLabel,
+        customLabelFont, customLabelColor, debug))
         return EXIT_FAILURE;
-    }
-
-    print_debug_ok(debug);
 
     return EXIT_SUCCESS;
 }
@@ -20,15 +20,27 @@
 #include <unistd.h>
 #include <string.h>
 #include <glib.h>
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #include "common.h"
 #include "gopt.h"
 #include "notification.h"
+#include "stats.h"
+#include "value-dbus.h"
 
 #define IMAGE_PATH PREFIX
-
-static VolumeObject *lastNotification = NULL;
+#define FRAME_INTERVAL (G_USEC_PER_SEC / 60) // in us
+
+static const char *icon_filenames[ICON_COUNT] = {
+    [ICON_HIGH] = "volume_high.svg",
+    [ICON_MEDIUM] = "volume_medium.svg",
+    [ICON_LOW] = "volume_low.svg",
+    [ICON_OFF] = "volume_off.svg",
+    [ICON_MUTED] = "volume_muted.svg",
+    [ICON_MICON] = "mic_on.svg",
+    [ICON_MICMUTED] = "mic_muted.svg",
+    [ICON_BRIGHTNESS] = "brightness.svg",
+};
 
 typedef struct
 {
@@ -37,12 +49,14 @@ typedef struct
 
 GType volume_object_get_type(void);
 gboolean volume_object_notify(VolumeObject *obj,
+    const gchar *sender,
+    const gchar *channel_name,
     gint value,
     gint valueType,
-    gchar *custom_icon_path,
-    gchar *custom_label_text,
-    gchar *custom_label_font_family_and_size,
-    gchar *custom_label_font_color,
+    const gchar *custom_icon_path,
+    const gchar *custom_label_text,
+    const gchar *custom_label_font_family_and_size,
+    const gchar *custom_label_font_color,
     GError **error
 );
 
@@ -71,37 +85,168 @@ gboolean volume_object_notify(VolumeObject *obj,
 
 G_DEFINE_TYPE(VolumeObject, volume_object, G_TYPE_OBJECT)
 
-#include "value-daemon-stub.h"
-
 static void volume_object_init(VolumeObject *obj)
 {
     g_assert(obj != NULL);
-    obj->notification = NULL;
+    obj->channel_count = 0;
 }
 
 static void volume_object_class_init(VolumeObjectClass *klass)
 {
     g_assert(klass != NULL);
+}
 
-    dbus_g_object_type_install_info(VOLUME_TYPE_OBJECT,
-        &dbus_glib_volume_object_object_info);
+static gboolean
+deadline_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    // one-shot: stay dormant until the deadline is armed again
+    g_source_set_ready_time(source, -1);
+    return callback(user_data);
 }
 
+static GSourceFuncs deadline_funcs = {
+    NULL,
+    NULL,
+    deadline_dispatch,
+    NULL
+};
+
 static gboolean
-time_handler(VolumeObject *obj)
+hide_handler(Channel *channel)
 {
-    g_assert(obj != NULL);
+    g_assert(channel != NULL);
+
+    VolumeObject *obj = channel->owner;
+
+    hideNotification(channel);
+    print_debug_ok(obj->debug);
+
+    if(obj->debug)
+        g_print("Paint cache: background %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses; "
+            "shape mask %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses; "
+            "palette %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses\n",
+            stats.background_hits, stats.background_misses,
+            stats.mask_hits, stats.mask_misses,
+            stats.palette_hits, stats.palette_misses);
+
+    // the cost so far, frames are only rendered for the values shown
+    if(obj->debug && obj->prerender_bars && obj->progressbar != NULL)
+        g_print("Progress bar frame table: %d of %d frames rendered, %lu KiB\n",
+            obj->progressbar->frames_rendered, PROGRESSBAR_FRAMES,
+            (gulong) (progressbar_frame_size(obj->progressbar) * obj->progressbar->frames_rendered / 1024));
+
+    return TRUE;
+}
+
+static gboolean
+idle_exit_handler(VolumeObject *obj)
+{
+    GDBusConnection *connection = g_dbus_interface_skeleton_get_connection(obj->skeleton);
+
+    print_debug("Exiting after being idle.\n", obj->debug);
+
+    // the bus starts a new instance for the next call once the name is released
+    g_bus_unown_name(obj->owner_id);
+    shared_state_unlink(obj->shared);
+
+    if(connection != NULL)
+        g_dbus_connection_flush_sync(connection, NULL, NULL);
+
+    exit(EXIT_SUCCESS);
+}
 
-    obj->time_left--;
+GdkPixbuf *createPixbufFromFilename(VolumeObject *obj, const char *filename, int max_size)
+{
+#define FILENAMELENGTH 513
+    char filePath[FILENAMELENGTH];
+    const char *imagePath = g_getenv("VOLNOTI_DATADIR"); // lets bench.sh run uninstalled
+    filePath[0] = '\0';
+    strncat(filePath, imagePath != NULL ? imagePath : IMAGE_PATH, FILENAMELENGTH - 1);
+    strncat(filePath, filename, FILENAMELENGTH - 1);
+#undef FILENAMELENGTH
 
-    if(obj->time_left <= 0)
+    // rendered by an earlier run of the daemon
+    GdkPixbuf *icon = raster_cache_lookup(obj->raster_cache, filePath, max_size);
+
+    if(icon != NULL)
+        return icon;
+
+    GError *error = NULL;
+    icon = load_pixbuf(filePath, max_size, &error);
+    stats.icon_loads++;
+
+    if(error)
     {
-        destroyNotification(obj);
-        print_debug_ok(obj->debug);
-        return FALSE;
+#define ERRORMSGLEN 513
+        char failedLoadMessage[ERRORMSGLEN];
+        failedLoadMessage[0] = '\0';
+        strncat(failedLoadMessage, "Couldn't load ", ERRORMSGLEN - 1);
+        strncat(failedLoadMessage, filePath, ERRORMSGLEN - 1);
+        strncat(failedLoadMessage, ".", ERRORMSGLEN - 1);
+#undef ERRORMSGLEN
+
+        handle_error(failedLoadMessage, error->message, TRUE);
     }
 
-    return TRUE;
+    raster_cache_add(obj->raster_cache, filePath, max_size, icon);
+    return icon;
+}
+
+// decodes a built-in icon the first time it is shown
+static GdkPixbuf *
+get_builtin_icon(VolumeObject *obj, BuiltinIcon icon)
+{
+    if(obj->icons[icon] == NULL)
+        obj->icons[icon] = createPixbufFromFilename(obj, icon_filenames[icon], MAX_ICON_SIZE);
+
+    return obj->icons[icon];
+}
+
+static ProgressBar *
+get_progressbar(VolumeObject *obj)
+{
+    if(obj->progressbar != NULL)
+        return obj->progressbar;
+
+    GdkPixbuf *progressbar_empty = createPixbufFromFilename(obj, "progressbar_empty.png", 0);
+    GdkPixbuf *progressbar_full = createPixbufFromFilename(obj, "progressbar_full.png", 0);
+
+    // check that the images are of the same size
+    if(gdk_pixbuf_get_width(progressbar_empty) != gdk_pixbuf_get_width(progressbar_full) ||
+        gdk_pixbuf_get_height(progressbar_empty) != gdk_pixbuf_get_height(progressbar_full) ||
+        gdk_pixbuf_get_bits_per_sample(progressbar_empty) != gdk_pixbuf_get_bits_per_sample(progressbar_full))
+        handle_error("Progress bar images aren't of the same size or don't have the same number of bits per sample.", "Unknown(OOM?)", TRUE);
+
+    obj->progressbar = progressbar_new(progressbar_full, progressbar_empty, obj->prerender_bars);
+    g_object_unref(progressbar_empty);
+    g_object_unref(progressbar_full);
+
+    if(obj->debug && obj->prerender_bars)
+    {
+        gsize frame_size = progressbar_frame_size(obj->progressbar);
+        g_print("Progress bar frame table: %d frames of %lu bytes, %lu KiB when fully rendered\n",
+            PROGRESSBAR_FRAMES, (gulong) frame_size,
+            (gulong) (frame_size * PROGRESSBAR_FRAMES / 1024));
+    }
+
+    return obj->progressbar;
+}
+
+// decodes one image per idle iteration until all are loaded
+static gboolean
+warm_up(VolumeObject *obj)
+{
+    for(int icon = 0; icon < ICON_COUNT; icon++)
+        if(obj->icons[icon] == NULL)
+        {
+            get_builtin_icon(obj, icon);
+            return TRUE;
+        }
+
+    get_progressbar(obj);
+    print_debug("Warmed up the built-in images.\n", obj->debug);
+
+    return FALSE;
 }
 
 GdkPixbuf *getNotificationIconFromValueType(gint valueType, gint value, gchar *custom_icon_path, VolumeObject *obj)
@@ -109,118 +254,593 @@ GdkPixbuf *getNotificationIconFromValueType(gint valueType, gint value, gchar *c
     switch(valueType)
     {
         case CUSTOM:
-            GError *local_error = NULL;
-            GdkPixbuf *custom_icon = gdk_pixbuf_new_from_file(custom_icon_path, &local_error);
+            if(custom_icon_path != NULL)
+            {
+                GError *local_error = NULL;
+                GdkPixbuf *custom_icon = icon_cache_lookup(obj->icon_cache, custom_icon_path, &local_error);
+
+                // NULL without an error until the icon has been decoded, see on_icon_loaded
+                if(local_error == NULL)
+                    return custom_icon;
 
-            if(local_error != NULL)
-                handle_error("Couldn't load custom icon.", local_error->message, TRUE);
+                g_error_free(local_error);
+            }
 
-            return custom_icon;
+            // fall back to the volume icon matching the value
+            return getNotificationIconFromValueType(VOL_UNMUTED, value, NULL, obj);
 
         case BRIGHTNESS:
-            return obj->icon_brightness;
+            return g_object_ref(get_builtin_icon(obj, ICON_BRIGHTNESS));
 
         case VOL_MUTED:
-            return obj->icon_muted;
+            return g_object_ref(get_builtin_icon(obj, ICON_MUTED));
 
         case MIC_MUTED:
-            return obj->icon_micmuted;
+            return g_object_ref(get_builtin_icon(obj, ICON_MICMUTED));
 
         case MIC_UNMUTED:
-            return obj->icon_micon;
+            return g_object_ref(get_builtin_icon(obj, ICON_MICON));
 
         case VOL_UNMUTED:
-            return
-                value > 75 ? obj->icon_high
-                : value >= 50 ? obj->icon_medium
-                : value >= 25 ? obj->icon_low
-                : obj->icon_off;
+            return g_object_ref(get_builtin_icon(obj,
+                value > 75 ? ICON_HIGH
+                : value >= 50 ? ICON_MEDIUM
+                : value >= 25 ? ICON_LOW
+                : ICON_OFF));
 
         default:
-            return obj->icon_off;
+            return g_object_ref(get_builtin_icon(obj, ICON_OFF));
     }
 }
 
+static void
+on_icon_loaded(const gchar *path, GdkPixbuf *pixbuf, const GError *error, gpointer user_data)
+{
+    VolumeObject *obj = user_data;
+
+    if(error != NULL)
+        handle_error("Couldn't load custom icon.", error->message, FALSE);
+
+    for(guint index = 0; index < obj->channel_count; index++)
+    {
+        Channel *channel = &obj->channels[index];
+
+        // a later notification may have asked for another icon meanwhile
+        if(g_strcmp0(path, channel->awaited_icon_path) != 0)
+            continue;
+
+        g_free(channel->awaited_icon_path);
+        channel->awaited_icon_path = NULL;
+
+        if(channel->notification == NULL)
+            continue;
+
+        if(pixbuf != NULL)
+            set_notification_icon(GTK_WINDOW(channel->notification), pixbuf);
+        else
+        {
+            GdkPixbuf *fallback = getNotificationIconFromValueType(VOL_UNMUTED, channel->value, NULL, obj);
+            set_notification_icon(GTK_WINDOW(channel->notification), fallback);
+            g_object_unref(fallback);
+        }
+    }
+}
+
+static gboolean
+on_notification_expose(GtkWidget *widget, GdkEventExpose *event, Channel *channel)
+{
+    // bench.sh matches these against the times volnoti-show was called
+    if(channel->owner->debug && event->count == 0)
+        g_print("Painted at %" G_GINT64_FORMAT " us\n", g_get_real_time());
+
+    return FALSE;
+}
+
+/* Popups are override-redirect, so no window manager applies a gravity:
+   the top-left corner is worked out from the cached anchor and the size
+   the popup asks for. Unless force is set, the popup is only moved when
+   that size changed since it was last placed. */
+static void
+place_notification(Channel *channel, gboolean force)
+{
+    VolumeObject *obj = channel->owner;
+    GtkRequisition size;
+
+    gtk_widget_size_request(GTK_WIDGET(channel->notification), &size);
+
+    if(!force && size.width == channel->placed_width && size.height == channel->placed_height)
+        return;
+
+    channel->placed_width = size.width;
+    channel->placed_height = size.height;
+
+    gtk_window_set_position(channel->notification, GTK_WIN_POS_NONE);
+    move_notification(channel->notification,
+        obj->anchor_x + channel->x - obj->align_x * size.width / 2,
+        obj->anchor_y + channel->y - obj->align_y * size.height / 2);
+}
+
+static void
+update_anchor(GdkScreen *screen, VolumeObject *obj)
+{
+    static const struct
+    {
+        gint x; // 0 left, 1 centre, 2 right
+        gint y; // 0 top, 1 centre, 2 bottom
+    } anchors[POSITION_COUNT] = {
+        [POSITION_CENTER] = { 1, 1 },
+        [POSITION_TOP] = { 1, 0 },
+        [POSITION_BOTTOM] = { 1, 2 },
+        [POSITION_LEFT] = { 0, 1 },
+        [POSITION_RIGHT] = { 2, 1 },
+        [POSITION_TOP_LEFT] = { 0, 0 },
+        [POSITION_TOP_RIGHT] = { 2, 0 },
+        [POSITION_BOTTOM_LEFT] = { 0, 2 },
+        [POSITION_BOTTOM_RIGHT] = { 2, 2 },
+    };
+    GdkRectangle geometry;
+    gint monitor = obj->monitor;
+
+    if(monitor < 0 || monitor >= gdk_screen_get_n_monitors(screen))
+        monitor = gdk_screen_get_primary_monitor(screen);
+
+    gdk_screen_get_monitor_geometry(screen, monitor, &geometry);
+
+    obj->align_x = anchors[obj->position].x;
+    obj->align_y = anchors[obj->position].y;
+    obj->anchor_x = geometry.x + (anchors[obj->position].x == 0 ? SCREEN_MARGIN
+        : anchors[obj->position].x == 1 ? geometry.width / 2
+        : geometry.width - SCREEN_MARGIN);
+    obj->anchor_y = geometry.y + (anchors[obj->position].y == 0 ? SCREEN_MARGIN
+        : anchors[obj->position].y == 1 ? geometry.height / 2
+        : geometry.height - SCREEN_MARGIN);
+
+    if(obj->debug)
+        g_print("Placing popups at %d,%d on monitor %d.\n", obj->anchor_x, obj->anchor_y, monitor);
+
+    for(guint index = 0; index < obj->channel_count; index++)
+        if(obj->channels[index].notification != NULL)
+            place_notification(&obj->channels[index], TRUE);
+}
+
+static gboolean
+apply_notification(Channel *channel)
+{
+    g_assert(channel != NULL);
+
+    VolumeObject *obj = channel->owner;
+    NotificationState *state = &channel->pending;
+
+    channel->applySourceId = 0;
+    channel->last_applied = g_get_monotonic_time();
+
+    if(channel->pending_count > 1)
+    {
+        stats.updates_coalesced += channel->pending_count - 1;
+
+        if(obj->debug)
+            g_print("Coalesced %u updates into one repaint (%" G_GUINT64_FORMAT " in total)\n",
+                channel->pending_count, stats.updates_coalesced);
+    }
+
+    channel->pending_count = 0;
+    channel->valueType = state->valueType;
+    channel->value = state->value;
+
+    gboolean new_window = channel->notification == NULL;
+
+    // the window is built once and reused by every later notification
+    if(new_window)
+    {
+        print_debug("Creating new notification...", obj->debug);
+        channel->notification = create_notification(obj->settings);
+        g_signal_connect_after(G_OBJECT(channel->notification),
+            "expose-event",
+            G_CALLBACK(on_notification_expose),
+            channel);
+
+        gtk_widget_realize(GTK_WIDGET(channel->notification));
+        print_debug_ok(obj->debug);
+    }
+
+    GdkPixbuf *notificationIcon = getNotificationIconFromValueType(channel->valueType, channel->value, state->iconPath, obj);
+    g_free(channel->awaited_icon_path);
+    channel->awaited_icon_path = NULL;
+
+    if(notificationIcon != NULL)
+    {
+        set_notification_icon(GTK_WINDOW(channel->notification), notificationIcon);
+        g_object_unref(notificationIcon);
+    }
+    else
+    {
+        // keep showing the previous icon while the new one is decoded
+        channel->awaited_icon_path = g_strdup(state->iconPath);
+
+        // a new window has none, it would grow once the icon arrives
+        if(new_window)
+        {
+            GdkPixbuf *placeholder = getNotificationIconFromValueType(VOL_UNMUTED, channel->value, NULL, obj);
+            set_notification_icon(GTK_WINDOW(channel->notification), placeholder);
+            g_object_unref(placeholder);
+        }
+    }
+
+    gboolean show_progressbar = channel->value >= 0 && channel->value < PROGRESSBAR_FRAMES;
+
+    // prepare and set progress bar
+    if(show_progressbar)
+    {
+        GdkPixbuf *frame = progressbar_get_frame(get_progressbar(obj), channel->value);
+        set_progressbar_image(GTK_WINDOW(channel->notification), frame);
+        g_object_unref(frame);
+    }
+    else
+        set_progressbar_image(GTK_WINDOW(channel->notification), NULL);
+
+    set_notification_label(GTK_WINDOW(channel->notification), state->textBoxData);
+
+    g_source_set_ready_time(channel->hide_source, channel->last_applied + channel->timeout);
+
+    // the daemon is idle once the popup of every channel is gone
+    if(obj->exit_source != NULL)
+    {
+        gint64 deadline = channel->last_applied + channel->timeout + obj->exit_after_idle;
+
+        if(deadline > g_source_get_ready_time(obj->exit_source))
+            g_source_set_ready_time(obj->exit_source, deadline);
+    }
+
+    /* GTK forgets the position when the window unmaps, so it is placed on
+       every show, and again while shown whenever its contents resize it. */
+    place_notification(channel, !gtk_widget_get_visible(GTK_WIDGET(channel->notification)));
+
+    gtk_widget_show(GTK_WIDGET(channel->notification));
+
+    histogram_add(&stats.apply_time, g_get_monotonic_time() - channel->last_applied);
+
+    return FALSE;
+}
+
+static Channel *
+add_channel(VolumeObject *obj, const gchar *name)
+{
+    if(obj->channel_count == MAX_CHANNELS)
+        return NULL;
+
+    Channel *channel = &obj->channels[obj->channel_count++];
+
+    channel->owner = obj;
+    channel->name = g_quark_from_string(name);
+    channel->timeout = obj->timeout;
+    channel->hide_source = g_source_new(&deadline_funcs, sizeof(GSource));
+    g_source_set_callback(channel->hide_source, (GSourceFunc) hide_handler, channel, NULL);
+    g_source_attach(channel->hide_source, NULL);
+
+    return channel;
+}
+
+// returns the channel called name, or NULL if there is none
+static Channel *
+find_channel(VolumeObject *obj, const gchar *name)
+{
+    // only names that were used before have a quark
+    GQuark quark = name != NULL ? g_quark_try_string(name) : obj->channels[0].name;
+
+    if(quark != 0)
+        for(guint index = 0; index < obj->channel_count; index++)
+            if(obj->channels[index].name == quark)
+                return &obj->channels[index];
+
+    return NULL;
+}
+
+// returns the channel called name, which is added if it is new
+static Channel *
+get_channel(VolumeObject *obj, const gchar *name, GError **error)
+{
+    Channel *channel = find_channel(obj, name);
+
+    if(channel != NULL)
+        return channel;
+
+    channel = add_channel(obj, name);
+
+    if(channel == NULL)
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+            "Can't add the channel '%s', all %d channels are in use.", name, MAX_CHANNELS);
+    else if(obj->debug)
+        g_print("Added the channel '%s'.\n", name);
+
+    return channel;
+}
+
+// name[:timeout[:x,y]], as given to --channel
+static gboolean
+add_channel_spec(VolumeObject *obj, const gchar *spec)
+{
+    gchar **fields = g_strsplit(spec, ":", 3);
+    gboolean valid = fields[0] != NULL && fields[0][0] != '\0';
+    Channel *channel = NULL;
+    float timeout_in;
+
+    if(valid)
+    {
+        GError *error = NULL;
+        channel = get_channel(obj, fields[0], &error);
+
+        if(channel == NULL)
+        {
+            handle_error("Couldn't set up the channel", error->message, FALSE);
+            g_error_free(error);
+            valid = FALSE;
+        }
+    }
+
+    if(valid && fields[1] != NULL && fields[1][0] != '\0')
+    {
+        if(sscanf(fields[1], "%f", &timeout_in) == 1 && timeout_in > 0.0f)
+            channel->timeout = (gint64) (timeout_in * G_USEC_PER_SEC);
+        else
+            valid = FALSE;
+    }
+
+    if(valid && fields[1] != NULL && fields[2] != NULL)
+    {
+        if(sscanf(fields[2], "%d,%d", &channel->x, &channel->y) != 2)
+            valid = FALSE;
+    }
+
+    g_strfreev(fields);
+
+    return valid;
+}
+
 gboolean volume_object_notify(VolumeObject *obj,
+    const gchar *sender,
+    const gchar *channel_name,
     gint value,
     gint valueType,
-    gchar *custom_icon_path,
-    gchar *custom_label_text,
-    gchar *custom_label_font_family_and_size,
-    gchar *custom_label_font_color,
+    const gchar *custom_icon_path,
+    const gchar *custom_label_text,
+    const gchar *custom_label_font_family_and_size,
+    const gchar *custom_label_font_color,
     GError **error)
 {
     g_assert(obj != NULL);
 
-    destroyNotification(lastNotification);
-    lastNotification = obj;
+    gint64 start = g_get_monotonic_time();
+    gint64 limit_delay = 0;
+    GError *icon_error = NULL;
+
+    stats.notifies_received++;
 
-    gboolean myuted = valueType == VOL_MUTED;
-    gboolean micmuted = valueType == MIC_MUTED;
-    gboolean micunmuted = valueType == MIC_UNMUTED;
-    gboolean brightness = valueType == BRIGHTNESS;
-    gboolean custom = valueType == CUSTOM;
-    obj->valueType = valueType;
-    obj->value = value;
+    // updates without a sender come from shared memory and aren't limited
+    if(obj->rate_limiter != NULL && sender != NULL)
+        limit_delay = rate_limiter_take(obj->rate_limiter, sender);
 
-    if(obj->notification == NULL)
+    // a caller over its limit can't take up the free channels
+    if(limit_delay > 0 && channel_name != NULL && find_channel(obj, channel_name) == NULL)
     {
-        print_debug("Creating new notification...", obj->debug);
+        stats.rate_limit_rejects++;
 
-        TextBoxData textBoxData;
-        textBoxData.labelText = custom_label_text;
-        textBoxData.labelFontAndSize = custom_label_font_family_and_size;
-        textBoxData.labelColorRGB = custom_label_font_color;
+        if(obj->debug)
+            g_print("Rejected a notification of %s over its rate limit "
+                "(%" G_GUINT64_FORMAT " merged, %" G_GUINT64_FORMAT " rejected in total)\n",
+                sender, stats.rate_limit_merges, stats.rate_limit_rejects);
 
-        obj->notification = create_notification(obj->settings, textBoxData);
-        gtk_widget_realize(GTK_WIDGET(obj->notification));
-        obj->timeoutSourceId = g_timeout_add(100, (GSourceFunc) time_handler, (gpointer) obj);
-        print_debug_ok(obj->debug);
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_BUSY,
+            "Too many notifications, the channel '%s' isn't added.", channel_name);
+        return FALSE;
     }
 
-    GdkPixbuf *notificationIcon = getNotificationIconFromValueType(valueType, value, custom_icon_path, obj);
-    set_notification_icon(GTK_WINDOW(obj->notification), notificationIcon);
+    Channel *channel = get_channel(obj, channel_name, error);
 
-    gboolean show_progressbar = obj->value >= 0 && obj->value <= 100;
+    if(channel == NULL)
+        return FALSE;
 
-    // prepare and set progress bar
-    if(show_progressbar)
+    NotificationState *state = &channel->pending;
+
+    /* A missing custom icon is reported to the caller, but the popup is
+       still shown with a built-in icon. */
+    if(valueType == CUSTOM)
     {
-        gint width_full = obj->width_progressbar * obj->value / 100;
-
-        gdk_pixbuf_copy_area(
-            obj->image_progressbar_full,
-            0, 0,
-            width_full,
-            obj->height_progressbar,
-            obj->image_progressbar,
-            0, 0
-        );
-
-        gdk_pixbuf_copy_area(
-            obj->image_progressbar_empty,
-            width_full,
-            0,
-            obj->width_progressbar - width_full,
-            obj->height_progressbar,
-            obj->image_progressbar,
-            width_full,
-            0
-        );
-
-        set_progressbar_image(GTK_WINDOW(obj->notification), obj->image_progressbar);
+        if(custom_icon_path == NULL)
+            g_set_error_literal(&icon_error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                "No custom icon given.");
+        else
+            icon_cache_check(obj->icon_cache, custom_icon_path, &icon_error);
     }
-    else
+
+    // only the latest state of a burst gets rendered
+    state->value = value;
+    state->valueType = valueType;
+    g_free(state->iconPath);
+    state->iconPath = g_strdup(custom_icon_path);
+    g_free(state->textBoxData.labelText);
+    state->textBoxData.labelText = g_strdup(custom_label_text);
+    g_free(state->textBoxData.labelFontAndSize);
+    state->textBoxData.labelFontAndSize = g_strdup(custom_label_font_family_and_size);
+    g_free(state->textBoxData.labelColorRGB);
+    state->textBoxData.labelColorRGB = g_strdup(custom_label_font_color);
+    channel->pending_count++;
+
+    // over the limit, the update waits for the sender's next token
+    if(limit_delay > 0)
     {
-        set_progressbar_image(GTK_WINDOW(obj->notification), NULL);
+        stats.rate_limit_merges++;
+
+        if(obj->debug)
+            g_print("Merged a notification of %s over its rate limit "
+                "(%" G_GUINT64_FORMAT " merged, %" G_GUINT64_FORMAT " rejected in total)\n",
+                sender, stats.rate_limit_merges, stats.rate_limit_rejects);
     }
 
-    obj->time_left = obj->timeout;
-    gtk_widget_show_all(GTK_WIDGET(obj->notification));
+    if(channel->applySourceId == 0)
+    {
+        /* Apply before GTK resizes and redraws, but after the D-Bus messages
+           already queued, and at most once per display frame. */
+        gint64 delay = channel->last_applied + FRAME_INTERVAL - g_get_monotonic_time();
+
+        delay = MAX(delay, limit_delay);
+
+        if(delay <= 0)
+            channel->applySourceId = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                (GSourceFunc) apply_notification, (gpointer) channel, NULL);
+        else
+            channel->applySourceId = g_timeout_add_full(G_PRIORITY_HIGH_IDLE,
+                (guint) ((delay + 999) / 1000),
+                (GSourceFunc) apply_notification, (gpointer) channel, NULL);
+    }
+
+    histogram_add(&stats.notify_time, g_get_monotonic_time() - start);
+
+    if(icon_error != NULL)
+    {
+        g_propagate_error(error, icon_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+on_shared_update(gint value, gint value_type, VolumeObject *obj)
+{
+    stats.shared_updates++;
+
+    // shared memory has no icon path, so a custom valueType gets the fallback icon
+    volume_object_notify(obj, NULL, NULL, value, value_type, NULL, NULL, NULL, NULL, NULL);
+}
+
+// D-Bus has no NULL strings, an empty one means the argument is unset
+#define NULL_IF_EMPTY(string) ((string)[0] != '\0' ? (string) : NULL)
+
+static gboolean
+on_handle_notify(VolnotiVolumeNotification *skeleton,
+    GDBusMethodInvocation *invocation,
+    gint value,
+    gint valueType,
+    const gchar *custom_icon_path,
+    const gchar *custom_label_text,
+    const gchar *custom_label_font_family_and_size,
+    const gchar *custom_label_font_color,
+    VolumeObject *obj)
+{
+    GError *error = NULL;
+
+    if(volume_object_notify(obj,
+        g_dbus_method_invocation_get_sender(invocation),
+        NULL,
+        value,
+        valueType,
+        NULL_IF_EMPTY(custom_icon_path),
+        NULL_IF_EMPTY(custom_label_text),
+        NULL_IF_EMPTY(custom_label_font_family_and_size),
+        NULL_IF_EMPTY(custom_label_font_color),
+        &error))
+        volnoti_volume_notification_complete_notify(skeleton, invocation);
+    else
+        g_dbus_method_invocation_take_error(invocation, error);
+
+    return TRUE;
+}
+
+static gboolean
+on_handle_notify_channel(VolnotiVolumeNotification *skeleton,
+    GDBusMethodInvocation *invocation,
+    const gchar *channel,
+    gint value,
+    gint valueType,
+    const gchar *custom_icon_path,
+    const gchar *custom_label_text,
+    const gchar *custom_label_font_family_and_size,
+    const gchar *custom_label_font_color,
+    VolumeObject *obj)
+{
+    GError *error = NULL;
+
+    if(volume_object_notify(obj,
+        g_dbus_method_invocation_get_sender(invocation),
+        NULL_IF_EMPTY(channel),
+        value,
+        valueType,
+        NULL_IF_EMPTY(custom_icon_path),
+        NULL_IF_EMPTY(custom_label_text),
+        NULL_IF_EMPTY(custom_label_font_family_and_size),
+        NULL_IF_EMPTY(custom_label_font_color),
+        &error))
+        volnoti_volume_notification_complete_notify_channel(skeleton, invocation);
+    else
+        g_dbus_method_invocation_take_error(invocation, error);
+
+    return TRUE;
+}
+
+static gsize
+get_pixbuf_bytes(VolumeObject *obj)
+{
+    gsize size = icon_cache_get_size(obj->icon_cache);
+
+    if(obj->progressbar != NULL)
+        size += progressbar_get_size(obj->progressbar);
+
+    for(int icon = 0; icon < ICON_COUNT; icon++)
+        if(obj->icons[icon] != NULL)
+            size += get_pixbuf_size(obj->icons[icon]);
+
+    return size;
+}
+
+static gboolean
+on_handle_get_stats(VolnotiVolumeNotification *skeleton,
+    GDBusMethodInvocation *invocation,
+    VolumeObject *obj)
+{
+    volnoti_volume_notification_complete_get_stats(skeleton, invocation,
+        stats_to_variant(get_pixbuf_bytes(obj)));
 
     return TRUE;
 }
 
+static void
+on_bus_acquired(GDBusConnection *connection, const gchar *name, VolumeObject *obj)
+{
+    GError *error = NULL;
+
+    print_debug("Registering volume object...", obj->debug);
+
+    if(!g_dbus_interface_skeleton_export(obj->skeleton,
+        connection,
+        VALUE_SERVICE_OBJECT_PATH,
+        &error))
+        handle_error("Couldn't register volume object",
+            error->message,
+            TRUE);
+
+    print_debug_ok(obj->debug);
+}
+
+static void
+on_name_acquired(GDBusConnection *connection, const gchar *name, VolumeObject *obj)
+{
+    print_debug("Registered the service.\n", obj->debug);
+
+    if(obj->warm_up)
+        g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc) warm_up, obj, NULL);
+}
+
+static void
+on_name_lost(GDBusConnection *connection, const gchar *name, VolumeObject *obj)
+{
+    if(connection == NULL)
+        handle_error("Couldn't connect to D-Bus",
+            "Unknown(g_bus_own_name)",
+            TRUE);
+
+    handle_error("Failed to get the primary well-known name. Possible cause: An instance of volnoti may already be running",
+        name, TRUE);
+}
 
 static void print_usage(const char *filename, int failure)
 {
@@ -229,12 +849,26 @@ static void print_usage(const char *filename, int failure)
         " -h\t\t--help\t\t\thelp\n"
         " -v\t\t--verbose\t\tverbose\n"
         " -n\t\t--no-daemon\t\tdo not daemonize\n"
+        " -p\t\t--prerender-bars\tkeep a rendered progress bar frame for every value\n"
+        " -w\t\t--warm-up\t\tdecode the built-in images while idle instead of on first use\n"
         "\n"
         "Configuration:\n"
-        " -t <float>\t--timeout <float>\tnotification timeout in seconds with one optional decimal place\n"
+        " -t <float>\t--timeout <float>\tnotification timeout in seconds\n"
         " -a <float>\t--alpha <float>\t\ttransparency level (0.0 - 1.0, default %.2f)\n"
-        " -r <int>\t--corner-radius <int>\tradius of the round corners in pixels (default %d)\n",
-        filename, settings.alpha, settings.corner_radius);
+        " -r <int>\t--corner-radius <int>\tradius of the round corners in pixels (default %d)\n"
+        " -c <int>\t--icon-cache <int>\tmemory budget for decoded custom icons in KiB (default %d)\n"
+        " -e <int>\t--exit-after-idle <int>\texit after this many seconds without notifications\n"
+        " -C <spec>\t--channel <spec>\tset up a channel as name[:timeout[:x,y]], where x,y moves\n"
+        "\t\t\t\t\tits popup away from where the others are shown (repeatable)\n"
+        " -P <pos>\t--position <pos>\twhere to show popups: center, top, bottom, left, right,\n"
+        "\t\t\t\t\ttop-left, top-right, bottom-left or bottom-right (default center)\n"
+        " -m <int>\t--monitor <int>\t\tmonitor to show popups on (default: the primary one)\n"
+        " -S\t\t--shm\t\t\talso take value updates from volnoti-show --shm through shared memory\n"
+        " -l <spec>\t--max-notify-rate <spec>\n"
+        "\t\t\t\t\tlimit each D-Bus caller to rate[:burst], rate notifications per\n"
+        "\t\t\t\t\tsecond in bursts of up to burst (default: rate); updates over the\n"
+        "\t\t\t\t\tlimit are merged and shown once the caller is within it\n",
+        filename, settings.alpha, settings.corner_radius, DEFAULT_ICON_CACHE_SIZE);
 
     if(failure)
         exit(EXIT_FAILURE);
@@ -242,50 +876,32 @@ static void print_usage(const char *filename, int failure)
         exit(EXIT_SUCCESS);
 }
 
-GdkPixbuf *createPixbufFromFilename(const char *filename)
-{
-#define FILENAMELENGTH 513
-    char filePath[FILENAMELENGTH];
-    filePath[0] = '\0';
-    strncat(filePath, IMAGE_PATH, FILENAMELENGTH - 1);
-    strncat(filePath, filename, FILENAMELENGTH - 1);
-#undef FILENAMELENGTH
-
-    GError *error = NULL;
-    GdkPixbuf *icon = gdk_pixbuf_new_from_file(filePath, &error);
-
-    if(error)
-    {
-#define ERRORMSGLEN 513
-        char failedLoadMessage[ERRORMSGLEN];
-        failedLoadMessage[0] = '\0';
-        strncat(failedLoadMessage, "Couldn't load ", ERRORMSGLEN - 1);
-        strncat(failedLoadMessage, filePath, ERRORMSGLEN - 1);
-        strncat(failedLoadMessage, ".", ERRORMSGLEN - 1);
-#undef ERRORMSGLEN
-
-        handle_error(failedLoadMessage, error->message, TRUE);
-    }
-    return icon;
-}
-
 int main(int argc, char *argv[])
 {
     Settings settings = get_default_settings();
-    int timeout = 30; // in ms
+    gint64 timeout = 3 * G_USEC_PER_SEC; // in us
+    int icon_cache_size = DEFAULT_ICON_CACHE_SIZE; // in KiB
+    int exit_after_idle = 0; // in seconds, 0 keeps the daemon running
+    Position position = POSITION_CENTER;
+    int monitor = -1;
+    float max_notify_rate = 0.0f; // per second, 0 doesn't limit
+    float max_notify_burst = 0.0f;
 
-    void *options = gopt_sort(&argc, (const char **) argv, gopt_start(gopt_option('h', 0, gopt_shorts('h', '?'), gopt_longs("help", "HELP")), gopt_option('n', 0, gopt_shorts('n'), gopt_longs("no-daemon")), gopt_option('t', GOPT_ARG, gopt_shorts('t'), gopt_longs("timeout")), gopt_option('a', GOPT_ARG, gopt_shorts('a'), gopt_longs("alpha")), gopt_option('r', GOPT_ARG, gopt_shorts('r'), gopt_longs("corner-radius")), gopt_option('v', GOPT_REPEAT, gopt_shorts('v'), gopt_longs("verbose"))));
+    void *options = gopt_sort(&argc, (const char **) argv, gopt_start(gopt_option('h', 0, gopt_shorts('h', '?'), gopt_longs("help", "HELP")), gopt_option('n', 0, gopt_shorts('n'), gopt_longs("no-daemon")), gopt_option('t', GOPT_ARG, gopt_shorts('t'), gopt_longs("timeout")), gopt_option('a', GOPT_ARG, gopt_shorts('a'), gopt_longs("alpha")), gopt_option('r', GOPT_ARG, gopt_shorts('r'), gopt_longs("corner-radius")), gopt_option('c', GOPT_ARG, gopt_shorts('c'), gopt_longs("icon-cache")), gopt_option('p', 0, gopt_shorts('p'), gopt_longs("prerender-bars")), gopt_option('w', 0, gopt_shorts('w'), gopt_longs("warm-up")), gopt_option('e', GOPT_ARG, gopt_shorts('e'), gopt_longs("exit-after-idle")), gopt_option('C', GOPT_ARG | GOPT_REPEAT, gopt_shorts('C'), gopt_longs("channel")), gopt_option('P', GOPT_ARG, gopt_shorts('P'), gopt_longs("position")), gopt_option('m', GOPT_ARG, gopt_shorts('m'), gopt_longs("monitor")), gopt_option('S', 0, gopt_shorts('S'), gopt_longs("shm")), gopt_option('l', GOPT_ARG, gopt_shorts('l'), gopt_longs("max-notify-rate")), gopt_option('v', GOPT_REPEAT, gopt_shorts('v'), gopt_longs("verbose"))));
 
     int help = gopt(options, 'h');
     int debug = gopt(options, 'v');
     int no_daemon = gopt(options, 'n');
+    int prerender_bars = gopt(options, 'p');
+    int warm_up_images = gopt(options, 'w');
+    int use_shared_state = gopt(options, 'S');
 
     float timeout_in; // cmd argument. Unused if unsupplied. Uninitialization is safe (for now)
 
     if(gopt(options, 't'))
     {
         if(sscanf(gopt_arg_i(options, 't', 0), "%f", &timeout_in) == 1 && timeout_in > 0.0f)
-            timeout = (int) (timeout_in * 10);
+            timeout = (gint64) (timeout_in * G_USEC_PER_SEC);
         else
             print_usage(argv[0], TRUE);
     }
@@ -302,20 +918,73 @@ int main(int argc, char *argv[])
             print_usage(argv[0], TRUE);
     }
 
+    if(gopt(options, 'c'))
+    {
+        if(sscanf(gopt_arg_i(options, 'c', 0), "%d", &icon_cache_size) != 1 || icon_cache_size < 0)
+            print_usage(argv[0], TRUE);
+    }
+
+    if(gopt(options, 'e'))
+    {
+        if(sscanf(gopt_arg_i(options, 'e', 0), "%d", &exit_after_idle) != 1 || exit_after_idle <= 0)
+            print_usage(argv[0], TRUE);
+    }
+
+    if(gopt(options, 'P'))
+    {
+        static const char *position_names[POSITION_COUNT] = {
+            [POSITION_CENTER] = "center",
+            [POSITION_TOP] = "top",
+            [POSITION_BOTTOM] = "bottom",
+            [POSITION_LEFT] = "left",
+            [POSITION_RIGHT] = "right",
+            [POSITION_TOP_LEFT] = "top-left",
+            [POSITION_TOP_RIGHT] = "top-right",
+            [POSITION_BOTTOM_LEFT] = "bottom-left",
+            [POSITION_BOTTOM_RIGHT] = "bottom-right",
+        };
+        const char *name = gopt_arg_i(options, 'P', 0);
+
+        for(position = 0; position < POSITION_COUNT; position++)
+            if(strcmp(name, position_names[position]) == 0)
+                break;
+
+        if(position == POSITION_COUNT)
+            print_usage(argv[0], TRUE);
+    }
+
+    if(gopt(options, 'm'))
+    {
+        if(sscanf(gopt_arg_i(options, 'm', 0), "%d", &monitor) != 1 || monitor < 0)
+            print_usage(argv[0], TRUE);
+    }
+
+    if(gopt(options, 'l'))
+    {
+        int fields = sscanf(gopt_arg_i(options, 'l', 0), "%f:%f", &max_notify_rate, &max_notify_burst);
+
+        if(fields == 1)
+            max_notify_burst = MAX(max_notify_rate, 1.0f);
+
+        if(fields < 1 || max_notify_rate <= 0.0f || max_notify_burst < 1.0f)
+            print_usage(argv[0], TRUE);
+    }
+
+    // the channels are set up once the VolumeObject exists
+    gchar **channel_specs = g_new0(gchar *, gopt(options, 'C') + 1);
+
+    for(int index = 0; index < gopt(options, 'C'); index++)
+        channel_specs[index] = g_strdup(gopt_arg_i(options, 'C', index));
+
     gopt_free(options);
 
     if(help)
         print_usage(argv[0], FALSE);
 
-    DBusGConnection *bus = NULL;
-    DBusGProxy *bus_proxy = NULL;
     VolumeObject *status = NULL;
     GMainLoop *main_loop = NULL;
-    GError *error = NULL;
-    guint result;
 
-    // initialize GObject and GTK
-    g_type_init();
+    // initialize GTK
     g_log_set_always_fatal(G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL);
     gtk_init(&argc, &argv);
 
@@ -325,57 +994,6 @@ int main(int argc, char *argv[])
     if(main_loop == NULL)
         handle_error("Couldn't create GMainLoop", "Unknown(OOM?)", TRUE);
 
-    // connect to D-Bus
-    print_debug("Connecting to D-Bus...", debug);
-    bus = dbus_g_bus_get(DBUS_BUS_SESSION, &error);
-
-    if(error != NULL)
-        handle_error("Couldn't connect to D-Bus",
-            error->message,
-            TRUE);
-
-    print_debug_ok(debug);
-
-    // get the proxy
-    print_debug("Getting proxy...", debug);
-    bus_proxy = dbus_g_proxy_new_for_name(bus,
-        DBUS_SERVICE_DBUS,
-        DBUS_PATH_DBUS,
-        DBUS_INTERFACE_DBUS);
-
-    if(bus_proxy == NULL)
-        handle_error("Couldn't get a proxy for D-Bus",
-            "Unknown(dbus_g_proxy_new_for_name)",
-            TRUE);
-
-    print_debug_ok(debug);
-
-    // register the service
-    print_debug("Registering the service...", debug);
-
-    if(!dbus_g_proxy_call(bus_proxy,
-        "RequestName",
-        &error,
-
-        G_TYPE_STRING,
-        VALUE_SERVICE_NAME,
-        G_TYPE_UINT,
-        0,
-        G_TYPE_INVALID,
-
-        G_TYPE_UINT,
-        &result,
-        G_TYPE_INVALID))
-        handle_error("D-Bus.RequestName RPC failed",
-            error->message,
-            TRUE);
-
-    if(result != 1)
-        handle_error("Failed to get the primary well-known name. Possible cause: An instance of volnoti may already be running",
-            "RequestName result != 1", TRUE);
-
-    print_debug_ok(debug);
-
     // create the Volume object
     print_debug("Preparing data...", debug);
     status = g_object_new(VOLUME_TYPE_OBJECT, NULL);
@@ -386,46 +1004,46 @@ int main(int argc, char *argv[])
 
     status->debug = debug;
     status->timeout = timeout;
-    status->settings = settings;
+    status->position = position;
+    status->monitor = monitor;
 
-    status->icon_high = createPixbufFromFilename("volume_high.svg");
-    status->icon_medium = createPixbufFromFilename("volume_medium.svg");
-    status->icon_low = createPixbufFromFilename("volume_low.svg");
-    status->icon_off = createPixbufFromFilename("volume_off.svg");
-    status->icon_muted = createPixbufFromFilename("volume_muted.svg");
-    status->icon_micmuted = createPixbufFromFilename("mic_muted.svg");
-    status->icon_micon = createPixbufFromFilename("mic_on.svg");
-    status->icon_brightness = createPixbufFromFilename("brightness.svg");
+    // only a change of the screen geometry moves the popups
+    GdkScreen *screen = gdk_screen_get_default();
+    update_anchor(screen, status);
+    g_signal_connect(screen, "monitors-changed", G_CALLBACK(update_anchor), status);
+    g_signal_connect(screen, "size-changed", G_CALLBACK(update_anchor), status);
 
-    // progress bar
-    status->image_progressbar_empty = createPixbufFromFilename("progressbar_empty.png");
-    status->image_progressbar_full = createPixbufFromFilename("progressbar_full.png");
+    add_channel(status, DEFAULT_CHANNEL);
 
-    // check that the images are of the same size
-    if(gdk_pixbuf_get_width(status->image_progressbar_empty) != gdk_pixbuf_get_width(status->image_progressbar_full) ||
-        gdk_pixbuf_get_height(status->image_progressbar_empty) != gdk_pixbuf_get_height(status->image_progressbar_full) ||
-        gdk_pixbuf_get_bits_per_sample(status->image_progressbar_empty) != gdk_pixbuf_get_bits_per_sample(status->image_progressbar_full))
-        handle_error("Progress bar images aren't of the same size or don't have the same number of bits per sample.", "Unknown(OOM?)", TRUE);
+    for(int index = 0; channel_specs != NULL && channel_specs[index] != NULL; index++)
+        if(!add_channel_spec(status, channel_specs[index]))
+            print_usage(argv[0], TRUE);
 
-    // create pixbuf for combined image
-    status->width_progressbar = gdk_pixbuf_get_width(status->image_progressbar_empty);
-    status->height_progressbar = gdk_pixbuf_get_height(status->image_progressbar_empty);
-    status->image_progressbar = gdk_pixbuf_new(GDK_COLORSPACE_RGB,
-        TRUE,
-        gdk_pixbuf_get_bits_per_sample(status->image_progressbar_empty),
-        status->width_progressbar,
-        status->height_progressbar);
+    g_strfreev(channel_specs);
 
-    print_debug_ok(debug);
+    if(exit_after_idle > 0)
+    {
+        status->exit_after_idle = (gint64) exit_after_idle * G_USEC_PER_SEC;
+        status->exit_source = g_source_new(&deadline_funcs, sizeof(GSource));
+        g_source_set_callback(status->exit_source, (GSourceFunc) idle_exit_handler, status, NULL);
+        g_source_set_ready_time(status->exit_source, g_get_monotonic_time() + status->exit_after_idle);
+        g_source_attach(status->exit_source, NULL);
+    }
+    status->settings = settings;
 
-    // register the Volume object
-    print_debug("Registering volume object...", debug);
-    dbus_g_connection_register_g_object(bus,
-        VALUE_SERVICE_OBJECT_PATH,
-        G_OBJECT(status));
+    if(max_notify_rate > 0.0f)
+        status->rate_limiter = rate_limiter_new(max_notify_rate, max_notify_burst);
+
+    status->raster_cache = raster_cache_open(debug);
+    status->icon_cache = icon_cache_new((gsize) icon_cache_size * 1024, on_icon_loaded, status);
+
+    status->prerender_bars = prerender_bars;
+    status->warm_up = warm_up_images;
+
+    // built-in images are decoded on first use, see get_builtin_icon
     print_debug_ok(debug);
 
-    // daemonize
+    // daemonize before GDBus starts its worker thread
     if(!no_daemon)
     {
         print_debug("Daemonizing...\n", debug);
@@ -434,6 +1052,47 @@ int main(int argc, char *argv[])
             handle_error("failed to daemonize", "unknown", FALSE);
     }
 
+    // the watching thread must be started after daemon() forked
+    if(use_shared_state)
+    {
+        GError *error = NULL;
+
+        status->shared = shared_state_open(TRUE, &error);
+
+        if(status->shared == NULL)
+        {
+            handle_error("Couldn't set up shared memory", error->message, FALSE);
+            g_error_free(error);
+        }
+        else
+            shared_state_watch(status->shared, (SharedStateFunc) on_shared_update, status);
+    }
+
+    // register the service once the main loop runs
+    status->skeleton = G_DBUS_INTERFACE_SKELETON(volnoti_volume_notification_skeleton_new());
+    g_signal_connect(status->skeleton,
+        "handle-notify",
+        G_CALLBACK(on_handle_notify),
+        status);
+    g_signal_connect(status->skeleton,
+        "handle-notify-channel",
+        G_CALLBACK(on_handle_notify_channel),
+        status);
+    g_signal_connect(status->skeleton,
+        "handle-get-stats",
+        G_CALLBACK(on_handle_get_stats),
+        status);
+
+    print_debug("Registering the service...\n", debug);
+    status->owner_id = g_bus_own_name(G_BUS_TYPE_SESSION,
+        VALUE_SERVICE_NAME,
+        G_BUS_NAME_OWNER_FLAGS_NONE,
+        (GBusAcquiredCallback) on_bus_acquired,
+        (GBusNameAcquiredCallback) on_name_acquired,
+        (GBusNameLostCallback) on_name_lost,
+        status,
+        NULL);
+
     // Run forever
     print_debug("Running the main loop...\n", debug);
     g_main_loop_run(main_loop);
@@ -0,0 +1,327 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "iconcache.h"
+#include "notification.h"
+#include "stats.h"
+
+typedef struct
+{
+    gchar *path;
+    GdkPixbuf *pixbuf;
+    gsize size;
+    time_t mtime;
+    goffset file_size;
+    GList *link;
+} IconCacheEntry;
+
+typedef struct
+{
+    GError *error;
+    gint64 expires; // monotonic time in us
+} IconFailure;
+
+typedef struct
+{
+    IconCache *cache;
+    gchar *path;
+    GdkPixbuf *pixbuf;
+    GStatBuf st;
+    gboolean have_stat;
+} IconLoad;
+
+struct _IconCache
+{
+    GHashTable *entries;
+    GQueue lru; // most recently used first
+    gsize budget;
+    gsize used;
+
+    GHashTable *loading; // paths being decoded by a worker thread
+    GHashTable *failed; // paths that recently failed to load
+    IconLoadedFunc loaded;
+    gpointer user_data;
+};
+
+static void
+free_entry(IconCacheEntry *entry)
+{
+    g_object_unref(entry->pixbuf);
+    g_free(entry->path);
+    g_free(entry);
+}
+
+static void
+remove_entry(IconCache *cache, IconCacheEntry *entry)
+{
+    g_queue_delete_link(&cache->lru, entry->link);
+    cache->used -= entry->size;
+    g_hash_table_remove(cache->entries, entry->path);
+}
+
+static void
+evict(IconCache *cache)
+{
+    while(cache->used > cache->budget && !g_queue_is_empty(&cache->lru))
+        remove_entry(cache, g_queue_peek_tail(&cache->lru));
+}
+
+static void
+free_failure(IconFailure *failure)
+{
+    g_error_free(failure->error);
+    g_free(failure);
+}
+
+static gboolean
+failure_expired(gpointer path, IconFailure *failure, gint64 *now)
+{
+    return failure->expires <= *now;
+}
+
+static void
+add_failure(IconCache *cache, const gchar *path, const GError *error)
+{
+    gint64 now = g_get_monotonic_time();
+
+    /* Expired failures are otherwise only dropped when their path comes
+       again, and a broken script may send a new path every time. */
+    if(g_hash_table_size(cache->failed) >= ICON_FAILURE_MAX)
+    {
+        g_hash_table_foreach_remove(cache->failed, (GHRFunc) failure_expired, &now);
+
+        // all still fresh, any one of them makes room
+        if(g_hash_table_size(cache->failed) >= ICON_FAILURE_MAX)
+        {
+            GHashTableIter iter;
+
+            g_hash_table_iter_init(&iter, cache->failed);
+            g_hash_table_iter_next(&iter, NULL, NULL);
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+
+    IconFailure *failure = g_new0(IconFailure, 1);
+
+    failure->error = g_error_copy(error);
+    failure->expires = now + ICON_FAILURE_TTL;
+    g_hash_table_replace(cache->failed, g_strdup(path), failure);
+}
+
+// sets error and returns TRUE if path failed to load within ICON_FAILURE_TTL
+static gboolean
+lookup_failure(IconCache *cache, const gchar *path, GError **error)
+{
+    IconFailure *failure = g_hash_table_lookup(cache->failed, path);
+
+    if(failure == NULL)
+        return FALSE;
+
+    if(failure->expires <= g_get_monotonic_time())
+    {
+        g_hash_table_remove(cache->failed, path);
+        return FALSE;
+    }
+
+    g_propagate_error(error, g_error_copy(failure->error));
+
+    return TRUE;
+}
+
+static void
+insert_entry(IconCache *cache, IconLoad *load)
+{
+    IconCacheEntry *entry;
+    gsize size = get_pixbuf_size(load->pixbuf);
+
+    if(!load->have_stat || size > cache->budget)
+        return;
+
+    entry = g_hash_table_lookup(cache->entries, load->path);
+
+    if(entry != NULL)
+        remove_entry(cache, entry);
+
+    entry = g_new0(IconCacheEntry, 1);
+    entry->path = g_strdup(load->path);
+    entry->pixbuf = g_object_ref(load->pixbuf);
+    entry->size = size;
+    entry->mtime = load->st.st_mtime;
+    entry->file_size = load->st.st_size;
+
+    g_queue_push_head(&cache->lru, entry);
+    entry->link = g_queue_peek_head_link(&cache->lru);
+    g_hash_table_insert(cache->entries, entry->path, entry);
+    cache->used += size;
+
+    evict(cache);
+}
+
+static void
+free_load(IconLoad *load)
+{
+    if(load->pixbuf != NULL)
+        g_object_unref(load->pixbuf);
+
+    g_free(load->path);
+    g_free(load);
+}
+
+// runs in a worker thread, so it must not touch the cache itself
+static void
+decode_icon(GTask *task, gpointer source_object, IconLoad *load, GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    load->have_stat = g_stat(load->path, &load->st) == 0;
+    load->pixbuf = load_pixbuf(load->path, MAX_ICON_SIZE, &error);
+
+    if(load->pixbuf == NULL)
+        g_task_return_error(task, error);
+    else
+        g_task_return_boolean(task, TRUE);
+}
+
+static void
+on_icon_decoded(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    IconLoad *load = g_task_get_task_data(G_TASK(result));
+    IconCache *cache = load->cache;
+    GError *error = NULL;
+
+    g_hash_table_remove(cache->loading, load->path);
+    stats.icon_loads++;
+
+    if(g_task_propagate_boolean(G_TASK(result), &error))
+        insert_entry(cache, load);
+    else
+        add_failure(cache, load->path, error);
+
+    cache->loaded(load->path, load->pixbuf, error, cache->user_data);
+    g_clear_error(&error);
+}
+
+IconCache *
+icon_cache_new(gsize budget, IconLoadedFunc loaded, gpointer user_data)
+{
+    IconCache *cache = g_new0(IconCache, 1);
+
+    // the entry owns its key, so the table only frees the entry
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) free_entry);
+    g_queue_init(&cache->lru);
+    cache->budget = budget;
+    cache->loading = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    cache->failed = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) free_failure);
+    cache->loaded = loaded;
+    cache->user_data = user_data;
+
+    return cache;
+}
+
+gboolean
+icon_cache_check(IconCache *cache, const gchar *path, GError **error)
+{
+    GStatBuf st;
+
+    // counted here only, icon_cache_lookup sees the same notification again
+    if(lookup_failure(cache, path, error))
+    {
+        stats.icon_failure_hits++;
+        return FALSE;
+    }
+
+    // cached and pending icons are validated by icon_cache_lookup
+    if(g_hash_table_contains(cache->entries, path) || g_hash_table_contains(cache->loading, path))
+        return TRUE;
+
+    if(g_stat(path, &st) != 0)
+    {
+        int saved_errno = errno;
+        GError *local_error = g_error_new(G_FILE_ERROR,
+            g_file_error_from_errno(saved_errno),
+            "Failed to open file '%s': %s", path, g_strerror(saved_errno));
+
+        add_failure(cache, path, local_error);
+        g_propagate_error(error, local_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+GdkPixbuf *
+icon_cache_lookup(IconCache *cache, const gchar *path, GError **error)
+{
+    GStatBuf st;
+    IconCacheEntry *entry = g_hash_table_lookup(cache->entries, path);
+
+    if(entry != NULL)
+    {
+        if(g_stat(path, &st) == 0 && entry->mtime == st.st_mtime && entry->file_size == st.st_size)
+        {
+            g_queue_unlink(&cache->lru, entry->link);
+            g_queue_push_head_link(&cache->lru, entry->link);
+            stats.icon_cache_hits++;
+            return g_object_ref(entry->pixbuf);
+        }
+
+        // the file changed (or vanished) since it was cached
+        remove_entry(cache, entry);
+    }
+
+    if(lookup_failure(cache, path, error) || g_hash_table_contains(cache->loading, path))
+        return NULL;
+
+    IconLoad *load = g_new0(IconLoad, 1);
+    load->cache = cache;
+    load->path = g_strdup(path);
+
+    GTask *task = g_task_new(NULL, NULL, on_icon_decoded, NULL);
+    g_task_set_task_data(task, load, (GDestroyNotify) free_load);
+    g_task_run_in_thread(task, (GTaskThreadFunc) decode_icon);
+    g_object_unref(task);
+
+    g_hash_table_add(cache->loading, g_strdup(path));
+
+    return NULL;
+}
+
+gsize
+icon_cache_get_size(IconCache *cache)
+{
+    return cache->used;
+}
+
+void
+icon_cache_free(IconCache *cache)
+{
+    if(cache == NULL)
+        return;
+
+    g_hash_table_destroy(cache->entries);
+    g_hash_table_destroy(cache->loading);
+    g_hash_table_destroy(cache->failed);
+    g_queue_clear(&cache->lru);
+    g_free(cache);
+}
@@ -0,0 +1,48 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define DEFAULT_ICON_CACHE_SIZE 8192 // in KiB
+#define ICON_FAILURE_TTL (5 * G_USEC_PER_SEC)
+#define ICON_FAILURE_MAX 64 // paths remembered as failed at once
+
+/* Least-recently-used cache of decoded custom icons, rasterized at
+   MAX_ICON_SIZE. Entries are keyed by
+   the icon path and revalidated against its mtime and size, so an icon
+   edited on disk is reloaded. The byte budget covers the pixel data.
+
+   Icons missing from the cache are decoded in a worker thread; the
+   result is passed to the IconLoadedFunc back on the main loop, with
+   pixbuf set to NULL if decoding failed. Up to ICON_FAILURE_MAX paths
+   that failed are remembered for ICON_FAILURE_TTL and fail again without
+   touching the disk. */
+typedef struct _IconCache IconCache;
+
+typedef void (*IconLoadedFunc)(const gchar *path, GdkPixbuf *pixbuf, const GError *error, gpointer user_data);
+
+IconCache *icon_cache_new(gsize budget, IconLoadedFunc loaded, gpointer user_data);
+gboolean icon_cache_check(IconCache *cache, const gchar *path, GError **error);
+GdkPixbuf *icon_cache_lookup(IconCache *cache, const gchar *path, GError **error);
+gsize icon_cache_get_size(IconCache *cache);
+void icon_cache_free(IconCache *cache);
+
+#endif /* ICONCACHE_H */
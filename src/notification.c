@@ -21,6 +21,7 @@
 
 #include "notification.h"
 #include "common.h"
+#include "stats.h"
 
 #define USE_COMPOSITE
 
@@ -30,12 +31,14 @@
 #define DEFAULT_RADIUS          30
 #define DEFAULT_BORDER          (DEFAULT_RADIUS * 3 / 2)
 
-#define IMAGE_SIZE              110
 #define IMAGE_PADDING           (IMAGE_SIZE / 3)
 #define TEXT_PADDING            (IMAGE_SIZE / 8)
 #define BODY_X_OFFSET           (IMAGE_SIZE + 8)
-#define MAX_ICON_SIZE           IMAGE_SIZE
-#define MAX_PROGRESSBAR_SIZE    (IMAGE_SIZE * 18 / 10)
+
+#define LABEL_STYLE_CACHE_SIZE  16 // parsed fonts and colours, each
+#define PALETTE_CACHE_SIZE      4  // themes the reversed colours are kept for
+#define MASK_CACHE_SIZE         8  // shape masks, the popup's width follows its label
+#define DEFAULT_LABEL_COLOR     "#FFFFFF"
 
 typedef struct
 {
@@ -45,16 +48,44 @@ typedef struct
     GtkWidget *icon;
     GtkWidget *progressbarbox;
     GtkWidget *progressbar;
+    GtkWidget *textbox;
+    GtkWidget *label;
 
     int width;
     int height;
     int last_width;
     int last_height;
 
+    // background of the last expose and its key
+    cairo_surface_t *background;
+    int background_width;
+    int background_height;
+    GdkColor background_color;
+
+    // font and colour the label was last styled with
+    gchar *label_font;
+    gchar *label_color;
+
     gboolean composited;
+    gboolean shaped; // a mask is set on the window
     Settings settings;
 } WindowData;
 
+typedef struct
+{
+    gint64 key; // see mask_key()
+    GdkBitmap *mask;
+} ShapeMask;
+
+/* Shape masks shared by all windows, least recently used first. A label
+   can give the popup a new width on every notification, so only the last
+   MASK_CACHE_SIZE are kept; a window holds its own reference to the mask
+   it is shaped with. */
+static GPtrArray *shape_masks = NULL;
+
+// reversed colours by theme, see lookup_palette()
+static GPtrArray *palettes = NULL;
+
 Settings
 get_default_settings()
 {
@@ -98,7 +129,14 @@ color_reverse(const GdkColor *a, GdkColor *b)
     b->blue = blue * 65535.0;
 }
 
-static GdkPixbuf *
+// bytes of pixel data, including the padding at the end of each row
+gsize
+get_pixbuf_size(GdkPixbuf *pixbuf)
+{
+    return (gsize) gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
+}
+
+GdkPixbuf *
 scale_pixbuf(GdkPixbuf *pixbuf,
     int        max_width,
     int        max_height,
@@ -131,6 +169,7 @@ scale_pixbuf(GdkPixbuf *pixbuf,
 
         scale_x = (int) (pw * scale_factor);
         scale_y = (int) (ph * scale_factor);
+        stats.scale_operations++;
         return gdk_pixbuf_scale_simple(pixbuf,
             scale_x,
             scale_y,
@@ -140,6 +179,23 @@ scale_pixbuf(GdkPixbuf *pixbuf,
         return g_object_ref(pixbuf);
 }
 
+GdkPixbuf *
+load_pixbuf(const gchar *path, int max_size, GError **error)
+{
+    int width;
+    int height;
+
+    /* Rasterize straight at the target size instead of decoding at the
+       natural size and scaling down afterwards; smaller images are kept
+       as they are, just like scale_pixbuf() with no_stretch_hint. */
+    if(max_size > 0
+        && gdk_pixbuf_get_file_info(path, &width, &height) != NULL
+        && (width > max_size || height > max_size))
+        return gdk_pixbuf_new_from_file_at_size(path, max_size, max_size, error);
+
+    return gdk_pixbuf_new_from_file(path, error);
+}
+
 static void
 draw_round_rect(cairo_t *cr,
     gdouble  aspect,
@@ -237,11 +293,107 @@ fill_background(GtkWidget *widget, WindowData *windata, cairo_t *cr)
     //  cairo_stroke (cr);
 }
 
+static gint64
+mask_key(int width, int height, int radius)
+{
+    return ((gint64) (width & 0xFFFF) << 32) | ((height & 0xFFFF) << 16) | (radius & 0xFFFF);
+}
+
+static GdkBitmap *
+create_mask(WindowData *windata)
+{
+    GdkBitmap *mask;
+    cairo_t *cr;
+
+    mask = (GdkBitmap *) gdk_pixmap_new(NULL,
+        windata->width,
+        windata->height,
+        1);
+
+    if(mask == NULL)
+        return NULL;
+
+    cr = gdk_cairo_create(mask);
+
+    if(cairo_status(cr) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_destroy(cr);
+        g_object_unref(mask);
+        return NULL;
+    }
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_set_source_rgb(cr, 1.0f, 1.0f, 1.0f);
+    draw_round_rect(cr,
+        1.0f,
+        DEFAULT_X0,
+        DEFAULT_Y0,
+        windata->settings.corner_radius,
+        windata->width,
+        windata->height);
+    cairo_fill(cr);
+    cairo_destroy(cr);
+
+    return mask;
+}
+
+static void
+free_shape_mask(ShapeMask *entry)
+{
+    g_object_unref(entry->mask);
+    g_free(entry);
+}
+
+// returns the shared mask of the window's size and radius, NULL on failure
+static GdkBitmap *
+lookup_mask(WindowData *windata)
+{
+    gint64 key = mask_key(windata->width, windata->height, windata->settings.corner_radius);
+    ShapeMask *entry;
+
+    if(shape_masks == NULL)
+        shape_masks = g_ptr_array_new_with_free_func((GDestroyNotify) free_shape_mask);
+
+    for(guint i = 0; i < shape_masks->len; i++)
+    {
+        entry = g_ptr_array_index(shape_masks, i);
+
+        if(entry->key == key)
+        {
+            // most recently used last, without freeing the entry on the way
+            for(; i + 1 < shape_masks->len; i++)
+                shape_masks->pdata[i] = shape_masks->pdata[i + 1];
+
+            shape_masks->pdata[i] = entry;
+            stats.mask_hits++;
+            return entry->mask;
+        }
+    }
+
+    stats.mask_misses++;
+    GdkBitmap *mask = create_mask(windata);
+
+    if(mask == NULL)
+        return NULL;
+
+    if(shape_masks->len == MASK_CACHE_SIZE)
+        g_ptr_array_remove_index(shape_masks, 0);
+
+    entry = g_new(ShapeMask, 1);
+    entry->key = key;
+    entry->mask = mask;
+    g_ptr_array_add(shape_masks, entry);
+
+    return mask;
+}
+
 static void
 update_shape(WindowData *windata)
 {
     GdkBitmap *mask;
-    cairo_t *cr;
 
     if(windata->width == windata->last_width
         && windata->height == windata->last_height)
@@ -253,55 +405,50 @@ update_shape(WindowData *windata)
         windata->height = MAX(windata->win->allocation.height, 1);
     }
 
+    windata->last_width = windata->width;
+    windata->last_height = windata->height;
+
+    // the compositor blends the transparent corners, no mask is needed
     if(windata->composited)
     {
-        gtk_widget_shape_combine_mask(windata->win, NULL, 0, 0);
+        if(windata->shaped)
+        {
+            gtk_widget_shape_combine_mask(windata->win, NULL, 0, 0);
+            windata->shaped = FALSE;
+        }
+
         return;
     }
 
-    windata->last_width = windata->width;
-    windata->last_height = windata->height;
-    mask = (GdkBitmap *) gdk_pixmap_new(NULL,
-        windata->width,
-        windata->height,
-        1);
+    mask = lookup_mask(windata);
 
     if(mask == NULL)
         return;
 
-    cr = gdk_cairo_create(mask);
-
-    if(cairo_status(cr) == CAIRO_STATUS_SUCCESS)
-    {
-        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
-        cairo_paint(cr);
-
-        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-        cairo_set_source_rgb(cr, 1.0f, 1.0f, 1.0f);
-        draw_round_rect(cr,
-            1.0f,
-            DEFAULT_X0,
-            DEFAULT_Y0,
-            windata->settings.corner_radius,
-            windata->width,
-            windata->height);
-        cairo_fill(cr);
-
-        gtk_widget_shape_combine_mask(windata->win, mask, 0, 0);
-    }
+    gtk_widget_shape_combine_mask(windata->win, mask, 0, 0);
+    windata->shaped = TRUE;
+}
 
-    cairo_destroy(cr);
+static gboolean
+background_is_valid(GtkWidget *widget, WindowData *windata)
+{
+    const GdkColor *color = &widget->style->bg[GTK_STATE_NORMAL];
 
-    g_object_unref(mask);
+    // the corner radius and alpha are fixed per window
+    return windata->background != NULL
+        && windata->background_width == widget->allocation.width
+        && windata->background_height == widget->allocation.height
+        && gdk_color_equal(&windata->background_color, color);
 }
 
-
 static void
 paint_window(GtkWidget *widget, WindowData *windata)
 {
     cairo_t *context;
-    cairo_surface_t *surface;
     cairo_t *cr;
+    gint64 start = g_get_monotonic_time();
+
+    stats.exposes++;
 
     if(windata->width == 0 || windata->height == 0)
     {
@@ -311,75 +458,157 @@ paint_window(GtkWidget *widget, WindowData *windata)
 
     context = gdk_cairo_create(widget->window);
 
-    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
-    surface = cairo_surface_create_similar(cairo_get_target(context),
-        CAIRO_CONTENT_COLOR_ALPHA,
-        widget->allocation.width,
-        widget->allocation.height);
-    cr = cairo_create(surface);
-
-    fill_background(widget, windata, cr);
+    if(background_is_valid(widget, windata))
+        stats.background_hits++;
+    else
+    {
+        stats.background_misses++;
+
+        if(windata->background != NULL)
+            cairo_surface_destroy(windata->background);
+
+        windata->background = cairo_surface_create_similar(cairo_get_target(context),
+            CAIRO_CONTENT_COLOR_ALPHA,
+            widget->allocation.width,
+            widget->allocation.height);
+        windata->background_width = widget->allocation.width;
+        windata->background_height = widget->allocation.height;
+        windata->background_color = widget->style->bg[GTK_STATE_NORMAL];
+
+        cr = cairo_create(windata->background);
+        fill_background(widget, windata, cr);
+        cairo_destroy(cr);
+    }
 
-    cairo_destroy(cr);
-    cairo_set_source_surface(context, surface, 0, 0);
+    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(context, windata->background, 0, 0);
     cairo_paint(context);
-    cairo_surface_destroy(surface);
     cairo_destroy(context);
 
     update_shape(windata);
+
+    histogram_add(&stats.paint_time, g_get_monotonic_time() - start);
 }
 
+/* Reversed colours of a theme, kept as an RC style so a widget takes all
+   of them in one style recalculation. */
+typedef struct
+{
+    GdkColor bg[5];
+    GdkColor fg[5];
+    GtkRcStyle *rc_style;
+} Palette;
+
 static void
-override_style(GtkWidget *widget, GtkStyle *previous_style)
+free_palette(Palette *palette)
 {
-    GtkStateType state;
-    GtkStyle *style;
-    GdkColor     fg;
-    GdkColor     bg;
+    g_object_unref(palette->rc_style);
+    g_free(palette);
+}
 
-    style = gtk_style_copy(widget->style);
+static gboolean
+palette_matches(const Palette *palette, const GtkStyle *theme)
+{
+    for(int state = 0; state < (int) G_N_ELEMENTS(palette->bg); state++)
+        if(!gdk_color_equal(&palette->bg[state], &theme->bg[state])
+            || !gdk_color_equal(&palette->fg[state], &theme->fg[state]))
+            return FALSE;
 
-    if(previous_style == NULL
-        || (previous_style != NULL
-            && (previous_style->bg[GTK_STATE_NORMAL].red != style->bg[GTK_STATE_NORMAL].red
-                || previous_style->bg[GTK_STATE_NORMAL].green != style->bg[GTK_STATE_NORMAL].green
-                || previous_style->bg[GTK_STATE_NORMAL].blue != style->bg[GTK_STATE_NORMAL].blue)))
-    {
+    return TRUE;
+}
 
-        state = (GtkStateType) 0;
+static Palette *
+create_palette(const GtkStyle *theme)
+{
+    Palette *palette = g_new0(Palette, 1);
 
-        while(state < (GtkStateType) G_N_ELEMENTS(widget->style->bg))
-        {
-            color_reverse(&style->bg[state], &bg);
-            gtk_widget_modify_bg(widget, state, &bg);
-            state++;
-        }
+    palette->rc_style = gtk_rc_style_new();
 
+    for(int state = 0; state < (int) G_N_ELEMENTS(palette->bg); state++)
+    {
+        palette->bg[state] = theme->bg[state];
+        palette->fg[state] = theme->fg[state];
+        color_reverse(&theme->bg[state], &palette->rc_style->bg[state]);
+        color_reverse(&theme->fg[state], &palette->rc_style->fg[state]);
+        palette->rc_style->color_flags[state] |= GTK_RC_BG | GTK_RC_FG;
     }
 
-    if(previous_style == NULL
-        || (previous_style != NULL
-            && (previous_style->fg[GTK_STATE_NORMAL].red != style->fg[GTK_STATE_NORMAL].red
-                || previous_style->fg[GTK_STATE_NORMAL].green != style->fg[GTK_STATE_NORMAL].green
-                || previous_style->fg[GTK_STATE_NORMAL].blue != style->fg[GTK_STATE_NORMAL].blue)))
-    {
+    return palette;
+}
+
+/* Returns the style the theme gives the widget, without the colours set
+   on the widget itself. */
+static GtkStyle *
+get_theme_style(GtkWidget *widget)
+{
+    gchar *path;
+    gchar *class_path;
+    GtkStyle *theme;
+
+    gtk_widget_path(widget, NULL, &path, NULL);
+    gtk_widget_class_path(widget, NULL, &class_path, NULL);
+    theme = gtk_rc_get_style_by_paths(gtk_widget_get_settings(widget),
+        path, class_path, G_OBJECT_TYPE(widget));
+    g_free(path);
+    g_free(class_path);
+
+    return theme != NULL ? theme : gtk_widget_get_default_style();
+}
+
+// returns the reversed colours of the widget's theme, computed once per theme
+static GtkRcStyle *
+lookup_palette(GtkWidget *widget)
+{
+    GtkStyle *theme = get_theme_style(widget);
+    Palette *palette;
+
+    if(palettes == NULL)
+        palettes = g_ptr_array_new_with_free_func((GDestroyNotify) free_palette);
 
-        state = (GtkStateType) 0;
+    for(guint i = 0; i < palettes->len; i++)
+    {
+        palette = g_ptr_array_index(palettes, i);
 
-        while(state < (GtkStateType) G_N_ELEMENTS(widget->style->fg))
+        if(palette_matches(palette, theme))
         {
-            color_reverse(&style->fg[state], &fg);
-            gtk_widget_modify_fg(widget, state, &fg);
-            state++;
+            stats.palette_hits++;
+            return palette->rc_style;
         }
     }
 
-    g_object_unref(style);
+    stats.palette_misses++;
+
+    if(palettes->len == PALETTE_CACHE_SIZE)
+        g_ptr_array_remove_index(palettes, 0);
+
+    palette = create_palette(theme);
+    g_ptr_array_add(palettes, palette);
+
+    return palette->rc_style;
+}
+
+static void
+override_style(GtkWidget *widget)
+{
+    GtkRcStyle *rc_style = lookup_palette(widget);
+
+    // the widget has the colours already, the style was set by the theme
+    if(g_object_get_data(G_OBJECT(widget), "palette") == rc_style)
+        return;
+
+    gtk_widget_modify_style(widget, rc_style);
+    g_object_set_data_full(G_OBJECT(widget), "palette",
+        g_object_ref(rc_style), g_object_unref);
 }
 
 static void
 destroy_windata(WindowData *windata)
 {
+    if(windata->background != NULL)
+        cairo_surface_destroy(windata->background);
+
+    g_free(windata->label_font);
+    g_free(windata->label_color);
     g_free(windata);
 }
 
@@ -398,7 +627,7 @@ static void
 on_style_set(GtkWidget *widget, GtkStyle *previous_style, WindowData *windata)
 {
     g_signal_handlers_block_by_func(G_OBJECT(widget), on_style_set, windata);
-    override_style(widget, previous_style);
+    override_style(widget);
 
     gtk_widget_queue_draw(widget);
 
@@ -409,6 +638,10 @@ static void
 on_composited_changed(GtkWidget *window, WindowData *windata)
 {
     windata->composited = gdk_screen_is_composited(gtk_widget_get_screen(window));
+
+    // set or clear the mask even though the size is unchanged
+    windata->last_width = 0;
+    windata->last_height = 0;
     update_shape(windata);
 }
 
@@ -429,7 +662,7 @@ on_window_map(GtkWidget *widget, GdkEvent *event, WindowData *windata)
     return FALSE;
 }
 
-GtkWindow *create_notification(Settings settings, TextBoxData textBoxData)
+GtkWindow *create_notification(Settings settings)
 {
     WindowData *windata;
 
@@ -440,6 +673,8 @@ GtkWindow *create_notification(Settings settings, TextBoxData textBoxData)
     GdkScreen *screen;
 #endif
 
+    stats.windows_created++;
+
     // create WindowData object
     windata = g_new0(WindowData, 1);
 
@@ -540,43 +775,19 @@ GtkWindow *create_notification(Settings settings, TextBoxData textBoxData)
     gtk_widget_show(windata->progressbar);
     gtk_container_add(GTK_CONTAINER(windata->progressbarbox), windata->progressbar);
 
-    // textbox & text
-    if(textBoxData.labelText != NULL && strlen(textBoxData.labelText) != 0)
-    {
-        // TextBox
-        GtkWidget *textBox = gtk_alignment_new(0.5f, 0, 0, 0);
-        gtk_widget_show(textBox);
-        gtk_alignment_set_padding(GTK_ALIGNMENT(textBox),
-            TEXT_PADDING, 0, 0, 0);
-        gtk_box_pack_start(GTK_BOX(windata->main_vbox),
-            textBox,
-            FALSE, FALSE, 0);
-        gtk_widget_set_size_request(textBox, BODY_X_OFFSET, -1);
-
-
-        //  Text
-        GtkWidget *text = gtk_label_new(textBoxData.labelText);
-
-        if(textBoxData.labelFontAndSize != NULL)
-        {
-            PangoFontDescription *font_desc = pango_font_description_from_string(textBoxData.labelFontAndSize);
-            gtk_widget_modify_font(text, font_desc);
-        }
+    // textbox, shown only while a label is set
+    windata->textbox = gtk_alignment_new(0.5f, 0, 0, 0);
+    gtk_alignment_set_padding(GTK_ALIGNMENT(windata->textbox),
+        TEXT_PADDING, 0, 0, 0);
+    gtk_box_pack_start(GTK_BOX(windata->main_vbox),
+        windata->textbox,
+        FALSE, FALSE, 0);
+    gtk_widget_set_size_request(windata->textbox, BODY_X_OFFSET, -1);
 
-        GdkColor color;
-        gdk_color_parse(
-            (
-                textBoxData.labelColorRGB
-                ? textBoxData.labelColorRGB
-                : "#FFFFFF"
-                ),
-            &color
-        );
-        gtk_widget_modify_fg(text, GTK_STATE_NORMAL, &color);
-
-        gtk_widget_show(text);
-        gtk_container_add(GTK_CONTAINER(textBox), text);
-    }
+    // text
+    windata->label = gtk_label_new(NULL);
+    gtk_widget_show(windata->label);
+    gtk_container_add(GTK_CONTAINER(windata->textbox), windata->label);
 
     return GTK_WINDOW(win);
 }
@@ -589,14 +800,12 @@ move_notification(GtkWindow *win, int x, int y)
 
 
 void
-destroyNotification(VolumeObject *obj)
+hideNotification(Channel *channel)
 {
-    if(obj && obj->notification)
+    if(channel && channel->notification)
     {
-        print_debug("Destroying notification...", obj->debug);
-        gtk_widget_destroy(GTK_WIDGET(obj->notification));
-        g_source_remove(obj->timeoutSourceId);
-        obj->notification = NULL;
+        print_debug("Hiding notification...", channel->owner->debug);
+        gtk_widget_hide(GTK_WIDGET(channel->notification));
     }
 }
 
@@ -610,14 +819,22 @@ set_notification_icon(GtkWindow *nw, GdkPixbuf *pixbuf)
 
     g_assert(windata != NULL);
 
+    if(pixbuf != NULL && pixbuf == gtk_image_get_pixbuf(GTK_IMAGE(windata->icon)))
+        return;
+
     scaled = NULL;
 
     if(pixbuf != NULL)
     {
-        scaled = scale_pixbuf(pixbuf,
-            MAX_ICON_SIZE,
-            MAX_ICON_SIZE,
-            TRUE);
+        // icons from load_pixbuf() already fit and are used as they are
+        if(gdk_pixbuf_get_width(pixbuf) <= MAX_ICON_SIZE
+            && gdk_pixbuf_get_height(pixbuf) <= MAX_ICON_SIZE)
+            scaled = g_object_ref(pixbuf);
+        else
+            scaled = scale_pixbuf(pixbuf,
+                MAX_ICON_SIZE,
+                MAX_ICON_SIZE,
+                TRUE);
     }
 
     gtk_image_set_from_pixbuf(GTK_IMAGE(windata->icon), scaled);
@@ -651,10 +868,15 @@ set_progressbar_image(GtkWindow *nw, GdkPixbuf *pixbuf)
 
     if(pixbuf)
     {
-        scaled = scale_pixbuf(pixbuf,
-            MAX_PROGRESSBAR_SIZE,
-            MAX_PROGRESSBAR_SIZE,
-            TRUE);
+        // frames of the progress bar already fit and are used as they are
+        if(gdk_pixbuf_get_width(pixbuf) <= MAX_PROGRESSBAR_SIZE
+            && gdk_pixbuf_get_height(pixbuf) <= MAX_PROGRESSBAR_SIZE)
+            scaled = g_object_ref(pixbuf);
+        else
+            scaled = scale_pixbuf(pixbuf,
+                MAX_PROGRESSBAR_SIZE,
+                MAX_PROGRESSBAR_SIZE,
+                TRUE);
     }
 
     gtk_image_set_from_pixbuf(GTK_IMAGE(windata->progressbar), scaled);
@@ -663,16 +885,111 @@ set_progressbar_image(GtkWindow *nw, GdkPixbuf *pixbuf)
     {
         int pixbuf_width = gdk_pixbuf_get_width(scaled);
 
-        gtk_widget_show(windata->icon);
+        gtk_widget_show(windata->progressbar);
         gtk_widget_set_size_request(windata->progressbarbox,
             MAX(BODY_X_OFFSET, pixbuf_width), -1);
         g_object_unref(scaled);
     }
     else
     {
-        gtk_widget_hide(windata->icon);
+        gtk_widget_hide(windata->progressbar);
         gtk_widget_set_size_request(windata->progressbarbox,
             MAX_PROGRESSBAR_SIZE,
             -1);
     }
 }
+
+// parsed label fonts and colours by their strings, shared by all windows
+static GHashTable *label_fonts;
+static GHashTable *label_colors;
+
+static PangoFontDescription *
+lookup_label_font(const gchar *name)
+{
+    PangoFontDescription *font_desc;
+
+    if(label_fonts == NULL)
+        label_fonts = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify) pango_font_description_free);
+
+    font_desc = g_hash_table_lookup(label_fonts, name);
+
+    if(font_desc == NULL)
+    {
+        // a caller cycling through many fonts only costs a parse per notify
+        if(g_hash_table_size(label_fonts) >= LABEL_STYLE_CACHE_SIZE)
+            g_hash_table_remove_all(label_fonts);
+
+        font_desc = pango_font_description_from_string(name);
+        g_hash_table_insert(label_fonts, g_strdup(name), font_desc);
+    }
+
+    return font_desc;
+}
+
+static GdkColor *
+lookup_label_color(const gchar *name)
+{
+    GdkColor *color;
+
+    if(label_colors == NULL)
+        label_colors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    color = g_hash_table_lookup(label_colors, name);
+
+    if(color == NULL)
+    {
+        if(g_hash_table_size(label_colors) >= LABEL_STYLE_CACHE_SIZE)
+            g_hash_table_remove_all(label_colors);
+
+        color = g_new0(GdkColor, 1);
+
+        if(!gdk_color_parse(name, color))
+            gdk_color_parse(DEFAULT_LABEL_COLOR, color);
+
+        g_hash_table_insert(label_colors, g_strdup(name), color);
+    }
+
+    return color;
+}
+
+void
+set_notification_label(GtkWindow *nw, TextBoxData textBoxData)
+{
+    WindowData *windata = g_object_get_data(G_OBJECT(nw), "windata");
+    g_assert(windata != NULL);
+
+    if(textBoxData.labelText == NULL || strlen(textBoxData.labelText) == 0)
+    {
+        gtk_widget_hide(windata->textbox);
+        return;
+    }
+
+    const gchar *color = textBoxData.labelColorRGB != NULL ? textBoxData.labelColorRGB : DEFAULT_LABEL_COLOR;
+
+    /* Each of these makes GTK lay the label out and negotiate the size of
+       the window again, so only what changed is touched. */
+    if(strcmp(gtk_label_get_text(GTK_LABEL(windata->label)), textBoxData.labelText) != 0)
+    {
+        gtk_label_set_text(GTK_LABEL(windata->label), textBoxData.labelText);
+        stats.label_relayouts++;
+    }
+
+    if(g_strcmp0(windata->label_font, textBoxData.labelFontAndSize) != 0)
+    {
+        gtk_widget_modify_font(windata->label, textBoxData.labelFontAndSize != NULL
+            ? lookup_label_font(textBoxData.labelFontAndSize) : NULL);
+        g_free(windata->label_font);
+        windata->label_font = g_strdup(textBoxData.labelFontAndSize);
+        stats.label_relayouts++;
+    }
+
+    if(g_strcmp0(windata->label_color, color) != 0)
+    {
+        gtk_widget_modify_fg(windata->label, GTK_STATE_NORMAL, lookup_label_color(color));
+        g_free(windata->label_color);
+        windata->label_color = g_strdup(color);
+    }
+
+    gtk_widget_show(windata->textbox);
+}
@@ -22,6 +22,29 @@
 #include <cairo.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include "iconcache.h"
+#include "progressbar.h"
+#include "rastercache.h"
+#include "ratelimit.h"
+#include "sharedstate.h"
+
+#define IMAGE_SIZE              110
+#define MAX_ICON_SIZE           IMAGE_SIZE
+#define MAX_PROGRESSBAR_SIZE    (IMAGE_SIZE * 18 / 10)
+
+typedef enum
+{
+    ICON_HIGH,
+    ICON_MEDIUM,
+    ICON_LOW,
+    ICON_OFF,
+    ICON_MUTED,
+    ICON_MICON,
+    ICON_MICMUTED,
+    ICON_BRIGHTNESS,
+    ICON_COUNT
+} BuiltinIcon;
+
 typedef struct
 {
     gfloat alpha;
@@ -37,41 +60,123 @@ typedef struct
 
 typedef struct
 {
-    GObject parent;
+    gint value;
+    gint valueType;
+    gchar *iconPath;
+    TextBoxData textBoxData;
+} NotificationState;
+
+typedef enum
+{
+    POSITION_CENTER,
+    POSITION_TOP,
+    POSITION_BOTTOM,
+    POSITION_LEFT,
+    POSITION_RIGHT,
+    POSITION_TOP_LEFT,
+    POSITION_TOP_RIGHT,
+    POSITION_BOTTOM_LEFT,
+    POSITION_BOTTOM_RIGHT,
+    POSITION_COUNT
+} Position;
+
+#define SCREEN_MARGIN 32 // between the popup and the edge it is placed at
+
+#define MAX_CHANNELS 8
+#define DEFAULT_CHANNEL "default"
+
+typedef struct _VolumeObject VolumeObject;
+
+// one popup, with its own window, timeout and position
+typedef struct
+{
+    VolumeObject *owner;
+    GQuark name;
 
     gint value;
     gint valueType;
 
     GtkWindow *notification;
+    gchar *awaited_icon_path; // custom icon still being decoded
+
+    // latest requested state, applied at most once per frame
+    NotificationState pending;
+    guint pending_count;
+    guint applySourceId;
+    gint64 last_applied;
+
+    // hides the window once its deadline passes
+    GSource *hide_source;
+    gint64 timeout; // in us
+
+    // offset of the popup from the anchor of the monitor
+    gint x;
+    gint y;
+
+    // size the popup was last placed for, see place_notification
+    gint placed_width;
+    gint placed_height;
+} Channel;
+
+struct _VolumeObject
+{
+    GObject parent;
+
+    // the default channel comes first, the others are added on first use
+    Channel channels[MAX_CHANNELS];
+    guint channel_count;
+
+    // exports the object on the session bus
+    GDBusInterfaceSkeleton *skeleton;
+    guint owner_id;
+
+    // built-in icons, rasterized at MAX_ICON_SIZE on first use
+    GdkPixbuf *icons[ICON_COUNT];
+    gboolean warm_up;
+
+    // built-in images rasterized by earlier runs
+    RasterCache *raster_cache;
+
+    IconCache *icon_cache;
+
+    ProgressBar *progressbar; // NULL until the first bar is shown
+    gboolean prerender_bars;
+
+    gint64 timeout; // of channels not set up with --channel, in us
+
+    /* Popups are placed relative to an anchor on the chosen monitor. It is
+       computed when the screen geometry changes, not for every popup. */
+    Position position;
+    gint monitor; // -1 for the primary monitor
+    gint align_x; // the anchor is the popup's 0 left, 1 centre, 2 right
+    gint align_y; // and 0 top, 1 centre, 2 bottom
+    gint anchor_x;
+    gint anchor_y;
+
+    // value updates written to shared memory, see --shm
+    SharedState *shared;
+
+    // notifications per D-Bus sender, NULL without --max-notify-rate
+    RateLimiter *rate_limiter;
+
+    // exits once no notification was shown for exit_after_idle us
+    GSource *exit_source;
+    gint64 exit_after_idle;
 
-    GdkPixbuf *icon_high;
-    GdkPixbuf *icon_medium;
-    GdkPixbuf *icon_low;
-    GdkPixbuf *icon_off;
-    GdkPixbuf *icon_muted;
-    GdkPixbuf *icon_micon;
-    GdkPixbuf *icon_micmuted;
-    GdkPixbuf *icon_brightness;
-
-    GdkPixbuf *image_progressbar_empty;
-    GdkPixbuf *image_progressbar_full;
-    GdkPixbuf *image_progressbar;
-    gint width_progressbar;
-    gint height_progressbar;
-
-    gint time_left;
-    gint timeout;
-    guint timeoutSourceId;
     gboolean debug;
     Settings settings;
-} VolumeObject;
+};
 
 
 Settings get_default_settings();
-GtkWindow *create_notification(Settings settings, TextBoxData textBoxData);
+GdkPixbuf *load_pixbuf(const gchar *path, int max_size, GError **error);
+gsize get_pixbuf_size(GdkPixbuf *pixbuf);
+GdkPixbuf *scale_pixbuf(GdkPixbuf *pixbuf, int max_width, int max_height, gboolean no_stretch_hint);
+GtkWindow *create_notification(Settings settings);
 void move_notification(GtkWindow *win, int x, int y);
 void set_notification_icon(GtkWindow *nw, GdkPixbuf *pixbuf);
 void set_progressbar_image(GtkWindow *nw, GdkPixbuf *pixbuf);
-void destroyNotification(VolumeObject *obj);
+void set_notification_label(GtkWindow *nw, TextBoxData textBoxData);
+void hideNotification(Channel *channel);
 
 #endif /* NOTIFICATION_H */
\ No newline at end of file
@@ -0,0 +1,99 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Times composing a progress bar frame: the old way, copying both skins at
+   their own size and scaling the result, against progressbar_get_frame.
+   Usage: progressbar-bench <resdir> [<frames>] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "progressbar.h"
+#include "notification.h"
+
+static GdkPixbuf *
+load_skin(const char *resdir, const char *name)
+{
+    gchar *path = g_build_filename(resdir, name, NULL);
+    GError *error = NULL;
+    GdkPixbuf *skin = gdk_pixbuf_new_from_file(path, &error);
+
+    if(skin == NULL)
+    {
+        fprintf(stderr, "progressbar-bench: %s\n", error->message);
+        exit(EXIT_FAILURE);
+    }
+
+    g_free(path);
+    return skin;
+}
+
+static GdkPixbuf *
+compose_copy_area(GdkPixbuf *full, GdkPixbuf *empty, GdkPixbuf *image, gint value)
+{
+    gint width = gdk_pixbuf_get_width(empty);
+    gint height = gdk_pixbuf_get_height(empty);
+    gint width_full = width * value / 100;
+
+    gdk_pixbuf_copy_area(full, 0, 0, width_full, height, image, 0, 0);
+    gdk_pixbuf_copy_area(empty, width_full, 0, width - width_full, height, image, width_full, 0);
+
+    return scale_pixbuf(image, MAX_PROGRESSBAR_SIZE, MAX_PROGRESSBAR_SIZE, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <resdir> [<frames>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    gint frames = argc > 2 ? atoi(argv[2]) : 10000;
+    GdkPixbuf *full = load_skin(argv[1], "progressbar_full.png");
+    GdkPixbuf *empty = load_skin(argv[1], "progressbar_empty.png");
+    GdkPixbuf *image = gdk_pixbuf_copy(empty);
+    ProgressBar *bar = progressbar_new(full, empty, FALSE);
+    GTimer *timer = g_timer_new();
+
+    for(gint frame = 0; frame < frames; frame++)
+        g_object_unref(compose_copy_area(full, empty, image, frame % PROGRESSBAR_FRAMES));
+
+    gdouble copy_area = g_timer_elapsed(timer, NULL);
+    g_timer_start(timer);
+
+    for(gint frame = 0; frame < frames; frame++)
+        g_object_unref(progressbar_get_frame(bar, frame % PROGRESSBAR_FRAMES));
+
+    gdouble one_pass = g_timer_elapsed(timer, NULL);
+
+    printf("progress bar frame, %dx%d skins shown at %dx%d, %d frames\n",
+        gdk_pixbuf_get_width(empty), gdk_pixbuf_get_height(empty),
+        bar->width, bar->height, frames);
+    printf("%-24s %8.2f us/frame\n", "copy area and scale", copy_area * G_USEC_PER_SEC / frames);
+    printf("%-24s %8.2f us/frame\n", "one pass", one_pass * G_USEC_PER_SEC / frames);
+
+    g_timer_destroy(timer);
+    progressbar_free(bar);
+    g_object_unref(image);
+    g_object_unref(empty);
+    g_object_unref(full);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "progressbar.h"
+#include "notification.h"
+
+#define CHANNELS 4 // the skins are converted to RGBA
+
+// scales a skin to the on-screen size and gives it an alpha channel
+static GdkPixbuf *
+prepare_skin(GdkPixbuf *skin)
+{
+    GdkPixbuf *scaled = scale_pixbuf(skin, MAX_PROGRESSBAR_SIZE, MAX_PROGRESSBAR_SIZE, TRUE);
+    GdkPixbuf *prepared = gdk_pixbuf_add_alpha(scaled, FALSE, 0, 0, 0);
+
+    g_object_unref(scaled);
+
+    return prepared;
+}
+
+/* Mixes the pixel where the fill ends; coverage is how much of it is
+   filled, out of 255. The skins aren't premultiplied, so the colours are
+   weighted by their alpha. */
+static void
+blend_pixel(guchar *dest, const guchar *full, const guchar *empty, guint coverage)
+{
+    guint full_weight = full[3] * coverage;
+    guint empty_weight = empty[3] * (255 - coverage);
+    guint alpha = full_weight + empty_weight; // out of 255 * 255
+
+    for(int channel = 0; channel < 3; channel++)
+        dest[channel] = alpha == 0 ? 0
+            : (full[channel] * full_weight + empty[channel] * empty_weight + alpha / 2) / alpha;
+
+    dest[3] = (alpha + 127) / 255;
+}
+
+// fill is the filled part of the bar, from 0.0 to 1.0
+static void
+compose(ProgressBar *bar, GdkPixbuf *image, gdouble fill)
+{
+    gdouble fill_width = CLAMP(fill, 0.0, 1.0) * bar->width;
+    gint filled = (gint) fill_width;
+    guint coverage = (guint) ((fill_width - filled) * 255 + 0.5);
+    const guchar *full = gdk_pixbuf_get_pixels(bar->full);
+    const guchar *empty = gdk_pixbuf_get_pixels(bar->empty);
+    guchar *dest = gdk_pixbuf_get_pixels(image);
+    gint full_stride = gdk_pixbuf_get_rowstride(bar->full);
+    gint empty_stride = gdk_pixbuf_get_rowstride(bar->empty);
+    gint dest_stride = gdk_pixbuf_get_rowstride(image);
+    gint rest;
+
+    if(filled == bar->width)
+    {
+        filled--;
+        coverage = 255;
+    }
+
+    rest = bar->width - filled - 1;
+
+    // one pass: each row is a run of full, one mixed pixel and a run of empty
+    for(gint y = 0; y < bar->height; y++)
+    {
+        const guchar *full_row = full + (gsize) y * full_stride;
+        const guchar *empty_row = empty + (gsize) y * empty_stride;
+        guchar *dest_row = dest + (gsize) y * dest_stride;
+
+        memcpy(dest_row, full_row, (gsize) filled * CHANNELS);
+        blend_pixel(dest_row + filled * CHANNELS,
+            full_row + filled * CHANNELS,
+            empty_row + filled * CHANNELS,
+            coverage);
+        memcpy(dest_row + (filled + 1) * CHANNELS,
+            empty_row + (filled + 1) * CHANNELS,
+            (gsize) rest * CHANNELS);
+    }
+}
+
+ProgressBar *
+progressbar_new(GdkPixbuf *full, GdkPixbuf *empty, gboolean prerender)
+{
+    ProgressBar *bar = g_new0(ProgressBar, 1);
+
+    bar->full = prepare_skin(full);
+    bar->empty = prepare_skin(empty);
+    bar->width = gdk_pixbuf_get_width(bar->empty);
+    bar->height = gdk_pixbuf_get_height(bar->empty);
+    bar->prerender = prerender;
+
+    return bar;
+}
+
+/* Returns a new image of the bar filled to fill, from 0.0 to 1.0. Values
+   still arrive in whole percent, so only the frames of those are drawn;
+   the partly covered pixel just smooths where they end. */
+static GdkPixbuf *
+progressbar_render(ProgressBar *bar, gdouble fill)
+{
+    GdkPixbuf *image = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, bar->width, bar->height);
+
+    compose(bar, image, fill);
+
+    return image;
+}
+
+// returns a new reference to the frame of value, in percent
+GdkPixbuf *
+progressbar_get_frame(ProgressBar *bar, gint value)
+{
+    g_assert(value >= 0 && value < PROGRESSBAR_FRAMES);
+
+    // a new image each time, a window may still show the previous one
+    if(!bar->prerender)
+        return progressbar_render(bar, value / 100.0);
+
+    if(bar->frames[value] == NULL)
+    {
+        bar->frames[value] = progressbar_render(bar, value / 100.0);
+        bar->frames_rendered++;
+    }
+
+    return g_object_ref(bar->frames[value]);
+}
+
+gsize
+progressbar_frame_size(ProgressBar *bar)
+{
+    return get_pixbuf_size(bar->empty);
+}
+
+gsize
+progressbar_get_size(ProgressBar *bar)
+{
+    gsize size = get_pixbuf_size(bar->full) + get_pixbuf_size(bar->empty);
+
+    for(int value = 0; value < PROGRESSBAR_FRAMES; value++)
+        if(bar->frames[value] != NULL)
+            size += get_pixbuf_size(bar->frames[value]);
+
+    return size;
+}
+
+void
+progressbar_free(ProgressBar *bar)
+{
+    if(bar == NULL)
+        return;
+
+    for(int value = 0; value < PROGRESSBAR_FRAMES; value++)
+        if(bar->frames[value] != NULL)
+            g_object_unref(bar->frames[value]);
+
+    g_object_unref(bar->empty);
+    g_object_unref(bar->full);
+    g_free(bar);
+}
@@ -0,0 +1,47 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PROGRESSBAR_H
+#define PROGRESSBAR_H
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define PROGRESSBAR_FRAMES 101 // values 0 - 100
+
+typedef struct
+{
+    // skins, scaled once to the size the bar is shown at
+    GdkPixbuf *full;
+    GdkPixbuf *empty;
+    gint width;
+    gint height;
+
+    /* With prerendering, every value gets its own frame, rendered on first
+       use and kept for the lifetime of the bar. */
+    gboolean prerender;
+    GdkPixbuf *frames[PROGRESSBAR_FRAMES];
+    gint frames_rendered;
+} ProgressBar;
+
+ProgressBar *progressbar_new(GdkPixbuf *full, GdkPixbuf *empty, gboolean prerender);
+GdkPixbuf *progressbar_get_frame(ProgressBar *bar, gint value);
+gsize progressbar_frame_size(ProgressBar *bar);
+gsize progressbar_get_size(ProgressBar *bar);
+void progressbar_free(ProgressBar *bar);
+
+#endif /* PROGRESSBAR_H */
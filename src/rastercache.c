@@ -0,0 +1,358 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "common.h"
+#include "rastercache.h"
+#include "stats.h"
+
+#define RASTER_CACHE_MAGIC "VOLNOTIR"
+#define RASTER_CACHE_VERSION 1
+#define RASTER_CACHE_ALIGN 16 // of the pixel data in the file
+#define RASTER_CACHE_SAVE_DELAY 2 // in seconds, batches images decoded together
+
+/* The file is only read back by the user that wrote it, so everything is
+   in host byte order. It starts with the header and the records, then the
+   NUL-terminated source paths, then the pixels of each image in the
+   layout GdkPixbuf uses. */
+typedef struct
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 count;
+} RasterCacheHeader;
+
+typedef struct
+{
+    guint64 path_offset;
+    guint64 data_offset;
+    gint64 mtime;
+    gint64 file_size;
+    gint32 max_size;
+    gint32 width;
+    gint32 height;
+    gint32 rowstride;
+    gint32 has_alpha;
+    gint32 padding;
+} RasterCacheRecord;
+
+typedef struct
+{
+    gchar *path;
+    gint64 mtime;
+    gint64 file_size;
+    gint max_size;
+    const RasterCacheRecord *record; // in the mapping, NULL for new images
+    GdkPixbuf *pixbuf; // NULL until a mapped image is looked up
+} RasterEntry;
+
+struct _RasterCache
+{
+    gchar *filename;
+    GMappedFile *mapped;
+    GHashTable *entries;
+    guint save_source_id;
+    gboolean debug;
+};
+
+static void
+free_entry(RasterEntry *entry)
+{
+    if(entry->pixbuf != NULL)
+        g_object_unref(entry->pixbuf);
+
+    g_free(entry->path);
+    g_free(entry);
+}
+
+static void
+unref_mapping(guchar *pixels, gpointer data)
+{
+    g_mapped_file_unref(data);
+}
+
+static gboolean
+record_is_valid(const RasterCacheRecord *record, const gchar *contents, gsize length)
+{
+    gint64 row_length = (gint64) record->width * (record->has_alpha ? 4 : 3);
+
+    if(record->width <= 0 || record->height <= 0 || record->rowstride < row_length)
+        return FALSE;
+
+    if(record->path_offset >= length ||
+        memchr(contents + record->path_offset, '\0', length - record->path_offset) == NULL)
+        return FALSE;
+
+    return record->data_offset % RASTER_CACHE_ALIGN == 0 &&
+        record->data_offset <= length &&
+        (guint64) record->rowstride * record->height <= length - record->data_offset;
+}
+
+RasterCache *
+raster_cache_open(gboolean debug)
+{
+    RasterCache *cache = g_new0(RasterCache, 1);
+    GError *error = NULL;
+
+    cache->filename = g_build_filename(g_get_user_cache_dir(), "volnoti", RASTER_CACHE_FILE, NULL);
+    cache->debug = debug;
+
+    // keyed by entry->path, which free_entry releases
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) free_entry);
+
+    cache->mapped = g_mapped_file_new(cache->filename, FALSE, &error);
+
+    // no cache yet, it is written once something has been rasterized
+    if(cache->mapped == NULL)
+    {
+        g_error_free(error);
+        return cache;
+    }
+
+    const gchar *contents = g_mapped_file_get_contents(cache->mapped);
+    gsize length = g_mapped_file_get_length(cache->mapped);
+    const RasterCacheHeader *header = (const RasterCacheHeader *) contents;
+
+    if(length < sizeof(RasterCacheHeader) ||
+        memcmp(header->magic, RASTER_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RASTER_CACHE_VERSION ||
+        header->count > (length - sizeof(RasterCacheHeader)) / sizeof(RasterCacheRecord))
+    {
+        print_debug("Ignoring the invalid raster cache.\n", debug);
+        g_mapped_file_unref(cache->mapped);
+        cache->mapped = NULL;
+        return cache;
+    }
+
+    const RasterCacheRecord *records = (const RasterCacheRecord *) (contents + sizeof(RasterCacheHeader));
+
+    for(guint32 index = 0; index < header->count; index++)
+    {
+        const RasterCacheRecord *record = &records[index];
+
+        if(!record_is_valid(record, contents, length))
+            continue;
+
+        RasterEntry *entry = g_new0(RasterEntry, 1);
+        entry->path = g_strdup(contents + record->path_offset);
+        entry->mtime = record->mtime;
+        entry->file_size = record->file_size;
+        entry->max_size = record->max_size;
+        entry->record = record;
+        g_hash_table_replace(cache->entries, entry->path, entry);
+    }
+
+    if(debug)
+        g_print("Mapped %u images from the raster cache.\n", g_hash_table_size(cache->entries));
+
+    return cache;
+}
+
+// zero-copy: the pixbuf points into the mapping and keeps it alive
+static GdkPixbuf *
+get_entry_pixbuf(RasterCache *cache, RasterEntry *entry)
+{
+    const RasterCacheRecord *record = entry->record;
+
+    if(entry->pixbuf == NULL)
+        entry->pixbuf = gdk_pixbuf_new_from_data(
+            (const guchar *) g_mapped_file_get_contents(cache->mapped) + record->data_offset,
+            GDK_COLORSPACE_RGB, record->has_alpha, 8,
+            record->width, record->height, record->rowstride,
+            unref_mapping, g_mapped_file_ref(cache->mapped));
+
+    return entry->pixbuf;
+}
+
+GdkPixbuf *
+raster_cache_lookup(RasterCache *cache, const gchar *path, gint max_size)
+{
+    GStatBuf st;
+    RasterEntry *entry = g_hash_table_lookup(cache->entries, path);
+
+    if(entry == NULL || entry->max_size != max_size)
+        return NULL;
+
+    if(g_stat(path, &st) != 0 || entry->mtime != st.st_mtime || entry->file_size != st.st_size)
+    {
+        // the source changed, raster_cache_add replaces the image
+        g_hash_table_remove(cache->entries, path);
+        return NULL;
+    }
+
+    stats.raster_cache_hits++;
+
+    return g_object_ref(get_entry_pixbuf(cache, entry));
+}
+
+static void
+append_zeros(GByteArray *file, gsize count)
+{
+    static const guint8 zeros[RASTER_CACHE_ALIGN];
+
+    while(count > 0)
+    {
+        gsize chunk = MIN(count, sizeof(zeros));
+        g_byte_array_append(file, zeros, chunk);
+        count -= chunk;
+    }
+}
+
+static void
+append_pixels(GByteArray *file, RasterCacheRecord *record, GdkPixbuf *pixbuf)
+{
+    const guchar *pixels = gdk_pixbuf_read_pixels(pixbuf);
+    gint source_rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    gint row_length;
+
+    record->width = gdk_pixbuf_get_width(pixbuf);
+    record->height = gdk_pixbuf_get_height(pixbuf);
+    record->has_alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+
+    row_length = record->width * gdk_pixbuf_get_n_channels(pixbuf);
+    record->rowstride = (row_length + 3) & ~3;
+
+    append_zeros(file, (RASTER_CACHE_ALIGN - file->len % RASTER_CACHE_ALIGN) % RASTER_CACHE_ALIGN);
+    record->data_offset = file->len;
+
+    // the last row of a pixbuf may end before its rowstride does
+    for(gint y = 0; y < record->height; y++)
+    {
+        g_byte_array_append(file, pixels + (gsize) y * source_rowstride, row_length);
+        append_zeros(file, record->rowstride - row_length);
+    }
+}
+
+static gboolean
+save(RasterCache *cache)
+{
+    GStatBuf st;
+    GError *error = NULL;
+    GPtrArray *valid = g_ptr_array_new();
+    GHashTableIter iter;
+    RasterEntry *entry;
+
+    cache->save_source_id = 0;
+
+    // drop the images of sources that changed or disappeared
+    g_hash_table_iter_init(&iter, cache->entries);
+
+    while(g_hash_table_iter_next(&iter, NULL, (gpointer *) &entry))
+        if(g_stat(entry->path, &st) == 0 && entry->mtime == st.st_mtime && entry->file_size == st.st_size)
+            g_ptr_array_add(valid, entry);
+
+    RasterCacheHeader header;
+    RasterCacheRecord *records = g_new0(RasterCacheRecord, valid->len);
+    GByteArray *file = g_byte_array_new();
+
+    memcpy(header.magic, RASTER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = RASTER_CACHE_VERSION;
+    header.count = valid->len;
+
+    // the header and the records are filled in once the offsets are known
+    append_zeros(file, sizeof(RasterCacheHeader) + valid->len * sizeof(RasterCacheRecord));
+
+    for(guint index = 0; index < valid->len; index++)
+    {
+        entry = g_ptr_array_index(valid, index);
+        records[index].path_offset = file->len;
+        g_byte_array_append(file, (const guint8 *) entry->path, strlen(entry->path) + 1);
+    }
+
+    for(guint index = 0; index < valid->len; index++)
+    {
+        entry = g_ptr_array_index(valid, index);
+        records[index].mtime = entry->mtime;
+        records[index].file_size = entry->file_size;
+        records[index].max_size = entry->max_size;
+        append_pixels(file, &records[index], get_entry_pixbuf(cache, entry));
+    }
+
+    memcpy(file->data, &header, sizeof(RasterCacheHeader));
+    memcpy(file->data + sizeof(RasterCacheHeader), records, valid->len * sizeof(RasterCacheRecord));
+
+    /* The new file is renamed over the old one, so images that still point
+       into the old mapping stay valid. */
+    gchar *directory = g_path_get_dirname(cache->filename);
+
+    if(g_mkdir_with_parents(directory, 0700) != 0 ||
+        !g_file_set_contents(cache->filename, (const gchar *) file->data, file->len, &error))
+    {
+        if(cache->debug)
+            g_print("Couldn't write the raster cache %s (%s)\n", cache->filename,
+                error != NULL ? error->message : g_strerror(errno));
+
+        g_clear_error(&error);
+    }
+    else if(cache->debug)
+        g_print("Saved %u images to the raster cache.\n", valid->len);
+
+    g_free(directory);
+    g_byte_array_free(file, TRUE);
+    g_free(records);
+    g_ptr_array_free(valid, TRUE);
+
+    return FALSE;
+}
+
+void
+raster_cache_add(RasterCache *cache, const gchar *path, gint max_size, GdkPixbuf *pixbuf)
+{
+    GStatBuf st;
+
+    // the file only stores the 8-bit RGB(A) layout every loader produces
+    if(g_stat(path, &st) != 0 ||
+        gdk_pixbuf_get_colorspace(pixbuf) != GDK_COLORSPACE_RGB ||
+        gdk_pixbuf_get_bits_per_sample(pixbuf) != 8)
+        return;
+
+    RasterEntry *entry = g_new0(RasterEntry, 1);
+    entry->path = g_strdup(path);
+    entry->mtime = st.st_mtime;
+    entry->file_size = st.st_size;
+    entry->max_size = max_size;
+    entry->pixbuf = g_object_ref(pixbuf);
+    g_hash_table_replace(cache->entries, entry->path, entry);
+
+    if(cache->save_source_id == 0)
+        cache->save_source_id = g_timeout_add_seconds_full(G_PRIORITY_LOW,
+            RASTER_CACHE_SAVE_DELAY, (GSourceFunc) save, cache, NULL);
+}
+
+void
+raster_cache_free(RasterCache *cache)
+{
+    if(cache == NULL)
+        return;
+
+    if(cache->save_source_id != 0)
+        g_source_remove(cache->save_source_id);
+
+    g_hash_table_destroy(cache->entries);
+
+    if(cache->mapped != NULL)
+        g_mapped_file_unref(cache->mapped);
+
+    g_free(cache->filename);
+    g_free(cache);
+}
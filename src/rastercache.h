@@ -0,0 +1,38 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RASTERCACHE_H
+#define RASTERCACHE_H
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define RASTER_CACHE_FILE "icons.cache" // in $XDG_CACHE_HOME/volnoti/
+
+/* On-disk cache of rasterized images, so that the daemon doesn't have to
+   render its SVGs again after a restart. Entries are keyed by the source
+   path and the size they were rasterized at, and revalidated against the
+   mtime and size of the source. The file is mapped at startup and cached
+   images point straight into the mapping. */
+typedef struct _RasterCache RasterCache;
+
+RasterCache *raster_cache_open(gboolean debug);
+GdkPixbuf *raster_cache_lookup(RasterCache *cache, const gchar *path, gint max_size);
+void raster_cache_add(RasterCache *cache, const gchar *path, gint max_size, GdkPixbuf *pixbuf);
+void raster_cache_free(RasterCache *cache);
+
+#endif /* RASTERCACHE_H */
@@ -0,0 +1,106 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ratelimit.h"
+
+typedef struct
+{
+    gdouble tokens; // below zero while a reserved token is outstanding
+    gint64 updated; // when tokens was last refilled, in us
+} Bucket;
+
+struct _RateLimiter
+{
+    gdouble rate; // tokens per second
+    gdouble burst;
+    GHashTable *buckets; // by sender
+};
+
+RateLimiter *
+rate_limiter_new(gdouble rate, gdouble burst)
+{
+    g_assert(rate > 0.0 && burst >= 1.0);
+
+    RateLimiter *limiter = g_new0(RateLimiter, 1);
+
+    limiter->rate = rate;
+    limiter->burst = burst;
+    limiter->buckets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    return limiter;
+}
+
+static void
+refill(RateLimiter *limiter, Bucket *bucket, gint64 now)
+{
+    bucket->tokens += (now - bucket->updated) * limiter->rate / G_USEC_PER_SEC;
+    bucket->tokens = MIN(bucket->tokens, limiter->burst);
+    bucket->updated = now;
+}
+
+static gboolean
+bucket_is_full(gpointer key, Bucket *bucket, RateLimiter *limiter)
+{
+    refill(limiter, bucket, g_get_monotonic_time());
+
+    return bucket->tokens >= limiter->burst;
+}
+
+// returns 0 if sender is within the limit, otherwise the us until it is
+gint64
+rate_limiter_take(RateLimiter *limiter, const gchar *sender)
+{
+    gint64 now = g_get_monotonic_time();
+    Bucket *bucket = g_hash_table_lookup(limiter->buckets, sender);
+
+    if(bucket == NULL)
+    {
+        // a full bucket is the same as none, and senders come and go
+        if(g_hash_table_size(limiter->buckets) >= RATE_LIMIT_MAX_SENDERS)
+            g_hash_table_foreach_remove(limiter->buckets, (GHRFunc) bucket_is_full, limiter);
+
+        bucket = g_new(Bucket, 1);
+        bucket->tokens = limiter->burst;
+        bucket->updated = now;
+        g_hash_table_insert(limiter->buckets, g_strdup(sender), bucket);
+    }
+    else
+        refill(limiter, bucket, now);
+
+    if(bucket->tokens >= 1.0)
+    {
+        bucket->tokens -= 1.0;
+        return 0;
+    }
+
+    // reserve the next token, unless an earlier update already did
+    if(bucket->tokens >= 0.0)
+        bucket->tokens -= 1.0;
+
+    return (gint64) (-bucket->tokens * G_USEC_PER_SEC / limiter->rate) + 1;
+}
+
+void
+rate_limiter_free(RateLimiter *limiter)
+{
+    if(limiter == NULL)
+        return;
+
+    g_hash_table_destroy(limiter->buckets);
+    g_free(limiter);
+}
@@ -0,0 +1,36 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <glib.h>
+
+#define RATE_LIMIT_MAX_SENDERS 64 // buckets kept before idle ones are dropped
+
+/* Token bucket per D-Bus sender: a sender may send burst notifications at
+   once, and rate per second after that. A sender over the limit is told
+   how long until it is back within it. The first notification over the
+   limit reserves the next token, so the update held back for it can be
+   rendered by then without going over the rate. */
+typedef struct _RateLimiter RateLimiter;
+
+RateLimiter *rate_limiter_new(gdouble rate, gdouble burst);
+gint64 rate_limiter_take(RateLimiter *limiter, const gchar *sender);
+void rate_limiter_free(RateLimiter *limiter);
+
+#endif /* RATELIMIT_H */
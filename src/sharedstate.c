@@ -0,0 +1,333 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib.h>
+
+#ifdef HAVE_LINUX_FUTEX_H
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "sharedstate.h"
+
+#define SHARED_STATE_MAGIC 0x766f6c6e // "voln"
+#define SHARED_STATE_VERSION 2
+#define SHARED_STATE_LOCK_TRIES 100 // 100 us apart, then writers use D-Bus
+#define SHARED_STATE_READ_TRIES 1000 // reads of a sequence a writer holds odd
+
+// the layout of the segment, shared by every process that maps it
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    gint owner; // pid of the daemon watching the segment, 0 once it exited
+    gint sequence; // odd while a writer updates the fields below
+    gint generation; // counts the updates
+    gint value;
+    gint value_type;
+} SharedStateData;
+
+struct _SharedState
+{
+    SharedStateData *data;
+    gchar *name;
+    gboolean created; // by this process, which unlinks it again
+    int fd; // locked by writers, -1 in the daemon
+
+    // only used by the daemon
+    SharedStateFunc func;
+    gpointer user_data;
+    gint dispatch_pending;
+};
+
+static void
+wait_for_change(SharedStateData *data, gint sequence)
+{
+#ifdef HAVE_LINUX_FUTEX_H
+    // returns at once if the sequence already changed
+    syscall(SYS_futex, &data->sequence, FUTEX_WAIT, sequence, NULL, NULL, 0);
+#else
+    g_assert_not_reached(); // the daemon doesn't create a segment, see shared_state_open
+#endif
+}
+
+static void
+wake_waiters(SharedStateData *data)
+{
+#ifdef HAVE_LINUX_FUTEX_H
+    syscall(SYS_futex, &data->sequence, FUTEX_WAKE, G_MAXINT, NULL, NULL, 0);
+#endif
+}
+
+// a daemon that crashed or was killed leaves its pid behind
+static gboolean
+owner_is_alive(gint owner)
+{
+    return owner > 0 && (kill(owner, 0) == 0 || errno == EPERM);
+}
+
+SharedState *
+shared_state_open(gboolean create, GError **error)
+{
+#ifndef HAVE_LINUX_FUTEX_H
+    /* Without futexes the daemon would have to poll the segment for as long
+       as it runs, so it keeps to D-Bus. */
+    if(create)
+    {
+        g_set_error_literal(error, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+            "Shared memory needs futex support, which this system lacks");
+        return NULL;
+    }
+#endif
+
+    // one segment per user
+    gchar *name = g_strdup_printf("/volnoti-%u", (guint) getuid());
+    int fd = shm_open(name, create ? O_RDWR | O_CREAT : O_RDWR, 0600);
+    int saved_errno = errno;
+    SharedStateData *data = MAP_FAILED;
+
+    if(fd >= 0)
+    {
+        struct stat st;
+
+        if(create && ftruncate(fd, sizeof(SharedStateData)) != 0)
+            saved_errno = errno;
+        // a segment shorter than the struct would fault on first access
+        else if(!create && (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(SharedStateData)))
+            saved_errno = EINVAL;
+        else
+        {
+            data = mmap(NULL, sizeof(SharedStateData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            saved_errno = errno;
+        }
+
+        // writers keep it to lock the segment
+        if(create || data == MAP_FAILED)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if(data == MAP_FAILED)
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+            "Couldn't map the shared memory segment %s: %s", name, g_strerror(saved_errno));
+        g_free(name);
+        return NULL;
+    }
+
+    if(create && data->magic == SHARED_STATE_MAGIC && data->version == SHARED_STATE_VERSION
+        && data->owner != getpid() && owner_is_alive(data->owner))
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_EXIST,
+            "The shared memory segment %s is used by the daemon with pid %d", name, data->owner);
+        munmap(data, sizeof(SharedStateData));
+        g_free(name);
+        return NULL;
+    }
+
+    // the daemon starts over, also after a writer died halfway through an update
+    if(create)
+    {
+        data->owner = getpid();
+        data->sequence = 0;
+        data->generation = 0;
+        data->value = 0;
+        data->value_type = 0;
+        data->version = SHARED_STATE_VERSION;
+        data->magic = SHARED_STATE_MAGIC;
+    }
+    else if(data->magic != SHARED_STATE_MAGIC || data->version != SHARED_STATE_VERSION)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+            "The shared memory segment %s has an unknown layout", name);
+        munmap(data, sizeof(SharedStateData));
+        close(fd);
+        g_free(name);
+        return NULL;
+    }
+    // nobody would read the update, the caller falls back to D-Bus
+    else if(!owner_is_alive(g_atomic_int_get(&data->owner)))
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+            "No daemon watches the shared memory segment %s", name);
+        munmap(data, sizeof(SharedStateData));
+        close(fd);
+        g_free(name);
+        return NULL;
+    }
+
+    SharedState *shared = g_new0(SharedState, 1);
+    shared->data = data;
+    shared->name = name;
+    shared->created = create;
+    shared->fd = fd;
+
+    return shared;
+}
+
+/* Writers take turns through a lock on the segment, which the kernel
+   releases when a writer dies. Returns FALSE if the lock stays taken, so
+   the caller can send the update over D-Bus instead. */
+gboolean
+shared_state_write(SharedState *shared, gint value, gint value_type)
+{
+    SharedStateData *data = shared->data;
+    gint sequence;
+    int tries = 0;
+
+    g_assert(shared->fd >= 0);
+
+    while(flock(shared->fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        if((errno != EWOULDBLOCK && errno != EINTR) || ++tries == SHARED_STATE_LOCK_TRIES)
+            return FALSE;
+
+        g_usleep(100);
+    }
+
+    // odd under the lock only if a writer died halfway through an update
+    sequence = g_atomic_int_get(&data->sequence);
+
+    if(sequence & 1)
+        sequence++;
+
+    g_atomic_int_set(&data->sequence, sequence + 1);
+    g_atomic_int_set(&data->value, value);
+    g_atomic_int_set(&data->value_type, value_type);
+    g_atomic_int_inc(&data->generation);
+    g_atomic_int_set(&data->sequence, sequence + 2);
+
+    flock(shared->fd, LOCK_UN);
+    wake_waiters(data);
+
+    return TRUE;
+}
+
+/* Returns FALSE if the sequence stayed odd, which the next writer fixes
+   and reports as another change. */
+gboolean
+shared_state_read(SharedState *shared, gint *value, gint *value_type)
+{
+    SharedStateData *data = shared->data;
+
+    for(int tries = 0; tries < SHARED_STATE_READ_TRIES; tries++)
+    {
+        gint sequence = g_atomic_int_get(&data->sequence);
+
+        *value = g_atomic_int_get(&data->value);
+        *value_type = g_atomic_int_get(&data->value_type);
+
+        if(!(sequence & 1) && sequence == g_atomic_int_get(&data->sequence))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+dispatch_update(SharedState *shared)
+{
+    gint value;
+    gint value_type;
+
+    // updates written from here on are dispatched again
+    g_atomic_int_set(&shared->dispatch_pending, FALSE);
+
+    if(shared_state_read(shared, &value, &value_type))
+        shared->func(value, value_type, shared->user_data);
+
+    return FALSE;
+}
+
+static gpointer
+watch_updates(SharedState *shared)
+{
+    SharedStateData *data = shared->data;
+    gint seen = g_atomic_int_get(&data->sequence);
+
+    for(;;)
+    {
+        gint sequence = g_atomic_int_get(&data->sequence);
+
+        if(sequence == seen || (sequence & 1))
+        {
+            wait_for_change(data, sequence);
+            continue;
+        }
+
+        seen = sequence;
+
+        // a burst of updates is handed to the main loop once
+        if(g_atomic_int_compare_and_exchange(&shared->dispatch_pending, FALSE, TRUE))
+            g_idle_add_full(G_PRIORITY_HIGH_IDLE, (GSourceFunc) dispatch_update, shared, NULL);
+    }
+
+    return NULL;
+}
+
+// calls func on the main loop after each update, from now on
+void
+shared_state_watch(SharedState *shared, SharedStateFunc func, gpointer user_data)
+{
+    shared->func = func;
+    shared->user_data = user_data;
+
+    g_thread_unref(g_thread_new("shared-state", (GThreadFunc) watch_updates, shared));
+}
+
+/* Removes the segment the daemon created, so writers fall back to D-Bus.
+   The mapping stays valid for the watching thread until the daemon exits. */
+void
+shared_state_unlink(SharedState *shared)
+{
+    if(shared == NULL || !shared->created)
+        return;
+
+    g_atomic_int_set(&shared->data->owner, 0);
+    shm_unlink(shared->name);
+    shared->created = FALSE;
+}
+
+void
+shared_state_close(SharedState *shared)
+{
+    if(shared == NULL)
+        return;
+
+    shared_state_unlink(shared);
+    munmap(shared->data, sizeof(SharedStateData));
+
+    if(shared->fd >= 0)
+        close(shared->fd);
+
+    g_free(shared->name);
+    g_free(shared);
+}
@@ -0,0 +1,42 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SHAREDSTATE_H
+#define SHAREDSTATE_H
+
+#include <glib.h>
+
+/* Shared memory fast path for frequent value updates, next to the notify
+   D-Bus method. The segment holds the latest value and valueType behind a
+   seqlock: writers lock the segment and make the sequence odd while they
+   update the fields, so readers can tell a torn read and retry. The
+   daemon waits for the sequence to change on a futex, and doesn't offer
+   the segment on systems without futexes. It records its pid in the
+   segment and unlinks it on exit; writers only open a segment whose
+   daemon is alive. */
+typedef struct _SharedState SharedState;
+
+typedef void (*SharedStateFunc)(gint value, gint value_type, gpointer user_data);
+
+SharedState *shared_state_open(gboolean create, GError **error);
+gboolean shared_state_write(SharedState *shared, gint value, gint value_type);
+gboolean shared_state_read(SharedState *shared, gint *value, gint *value_type);
+void shared_state_watch(SharedState *shared, SharedStateFunc func, gpointer user_data);
+void shared_state_unlink(SharedState *shared);
+void shared_state_close(SharedState *shared);
+
+#endif /* SHAREDSTATE_H */
@@ -0,0 +1,126 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "stats.h"
+
+Stats stats;
+
+void
+histogram_add(Histogram *histogram, gint64 duration)
+{
+    int bucket = 0;
+
+    if(duration < 0)
+        duration = 0;
+
+    while(bucket < HISTOGRAM_BUCKETS - 1 && duration >= ((gint64) 1 << bucket))
+        bucket++;
+
+    histogram->count++;
+    histogram->total += duration;
+    histogram->buckets[bucket]++;
+}
+
+static guint64
+histogram_mean(const Histogram *histogram)
+{
+    return histogram->count > 0 ? histogram->total / histogram->count : 0;
+}
+
+// upper bound of the bucket holding the given percentile, in us
+static guint64
+histogram_percentile(const Histogram *histogram, guint percentile)
+{
+    guint64 rank = (histogram->count * percentile + 99) / 100;
+    guint64 seen = 0;
+
+    if(histogram->count == 0)
+        return 0;
+
+    for(int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+
+        if(seen >= rank)
+            return (guint64) 1 << bucket;
+    }
+
+    return (guint64) 1 << (HISTOGRAM_BUCKETS - 1);
+}
+
+static void
+add_histogram(GVariantBuilder *builder, const gchar *name, const Histogram *histogram)
+{
+    gchar *key;
+
+    key = g_strconcat(name, "-mean-us", NULL);
+    g_variant_builder_add(builder, "{sv}", key, g_variant_new_uint64(histogram_mean(histogram)));
+    g_free(key);
+
+    key = g_strconcat(name, "-p99-us", NULL);
+    g_variant_builder_add(builder, "{sv}", key, g_variant_new_uint64(histogram_percentile(histogram, 99)));
+    g_free(key);
+
+    key = g_strconcat(name, "-histogram", NULL);
+    g_variant_builder_add(builder, "{sv}", key,
+        g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64,
+            histogram->buckets,
+            HISTOGRAM_BUCKETS,
+            sizeof(guint64)));
+    g_free(key);
+}
+
+#define ADD_COUNTER(builder, name, value) \
+    g_variant_builder_add((builder), "{sv}", (name), g_variant_new_uint64(value))
+
+GVariant *
+stats_to_variant(gsize pixbuf_bytes)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    ADD_COUNTER(&builder, "notifies-received", stats.notifies_received);
+    ADD_COUNTER(&builder, "shared-updates", stats.shared_updates);
+    ADD_COUNTER(&builder, "updates-coalesced", stats.updates_coalesced);
+    ADD_COUNTER(&builder, "rate-limit-merges", stats.rate_limit_merges);
+    ADD_COUNTER(&builder, "rate-limit-rejects", stats.rate_limit_rejects);
+    ADD_COUNTER(&builder, "windows-created", stats.windows_created);
+    ADD_COUNTER(&builder, "icon-loads", stats.icon_loads);
+    ADD_COUNTER(&builder, "icon-cache-hits", stats.icon_cache_hits);
+    ADD_COUNTER(&builder, "icon-failure-hits", stats.icon_failure_hits);
+    ADD_COUNTER(&builder, "raster-cache-hits", stats.raster_cache_hits);
+    ADD_COUNTER(&builder, "scale-operations", stats.scale_operations);
+    ADD_COUNTER(&builder, "label-relayouts", stats.label_relayouts);
+    ADD_COUNTER(&builder, "exposes", stats.exposes);
+    ADD_COUNTER(&builder, "background-cache-hits", stats.background_hits);
+    ADD_COUNTER(&builder, "background-cache-misses", stats.background_misses);
+    ADD_COUNTER(&builder, "mask-cache-hits", stats.mask_hits);
+    ADD_COUNTER(&builder, "mask-cache-misses", stats.mask_misses);
+    ADD_COUNTER(&builder, "palette-cache-hits", stats.palette_hits);
+    ADD_COUNTER(&builder, "palette-cache-misses", stats.palette_misses);
+    ADD_COUNTER(&builder, "resident-pixbuf-bytes", pixbuf_bytes);
+
+    add_histogram(&builder, "notify-time", &stats.notify_time);
+    add_histogram(&builder, "apply-time", &stats.apply_time);
+    add_histogram(&builder, "paint-time", &stats.paint_time);
+
+    return g_variant_builder_end(&builder);
+}
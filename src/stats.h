@@ -0,0 +1,67 @@
+/**
+ *  Volnoti - Lightweight Volume Notification
+ *  Copyright (C) 2011  David Brazdil <db538@cam.ac.uk>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <glib.h>
+
+/* Bucket i counts durations below 2^i us, above the previous bucket;
+   the last one also takes everything longer. */
+#define HISTOGRAM_BUCKETS 24
+
+typedef struct
+{
+    guint64 count;
+    guint64 total; // in us
+    guint64 buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+// counters of the daemon's hot path, reported by the GetStats method
+typedef struct
+{
+    guint64 notifies_received;
+    guint64 shared_updates;
+    guint64 updates_coalesced;
+    guint64 rate_limit_merges;
+    guint64 rate_limit_rejects;
+    guint64 windows_created;
+    guint64 icon_loads;
+    guint64 icon_cache_hits;
+    guint64 icon_failure_hits;
+    guint64 raster_cache_hits;
+    guint64 scale_operations;
+    guint64 label_relayouts;
+    guint64 exposes;
+    guint64 background_hits;
+    guint64 background_misses;
+    guint64 mask_hits;
+    guint64 mask_misses;
+    guint64 palette_hits;
+    guint64 palette_misses;
+
+    Histogram notify_time;
+    Histogram apply_time;
+    Histogram paint_time;
+} Stats;
+
+extern Stats stats;
+
+void histogram_add(Histogram *histogram, gint64 duration);
+GVariant *stats_to_variant(gsize pixbuf_bytes);
+
+#endif /* STATS_H */